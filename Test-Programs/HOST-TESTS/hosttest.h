@@ -0,0 +1,31 @@
+// ======================================================================
+// hosttest.h : checks for the myFP2ESP host tests
+// ======================================================================
+
+#ifndef hosttest_h
+#define hosttest_h
+
+#include <stdio.h>
+
+static int hosttest_checks;
+static int hosttest_failures;
+
+// count a check, print the failed ones, the test keeps going
+#define CHECK(cond) \
+  do { \
+    hosttest_checks++; \
+    if ( !(cond) ) \
+    { \
+      hosttest_failures++; \
+      printf("%s:%d: FAILED %s\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while (0)
+
+// print the result, use as the return value of main()
+inline int hosttest_result(const char *name)
+{
+  printf("%s: %d checks, %d failed\n", name, hosttest_checks, hosttest_failures);
+  return ( hosttest_failures == 0 ) ? 0 : 1;
+}
+
+#endif // #ifndef hosttest_h
@@ -0,0 +1,39 @@
+// ======================================================================
+// Arduino.h : host stand in for the parts of the Arduino core used by
+// the myFP2ESP sources under test. No hardware, millis() is set by the test
+// ======================================================================
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+// time, advanced by the test
+inline unsigned long &hosttest_millis(void)
+{
+  static unsigned long ms;
+  return ms;
+}
+
+inline unsigned long millis(void)
+{
+  return hosttest_millis();
+}
+
+// critical sections, the tests run the code under test in one thread unless they say otherwise
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+inline void portENTER_CRITICAL(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE *) {}
+
+#endif // #ifndef Arduino_h
@@ -0,0 +1,54 @@
+// ======================================================================
+// TMCStepper.h : host stand in for the TMC2209 driver on its UART. Every
+// register write or read the library would send is counted, and the values
+// written are kept, so a test sees the UART traffic of the code under test
+// ======================================================================
+
+#ifndef TMCStepper_h
+#define TMCStepper_h
+
+#include <Arduino.h>
+
+class TMC2209Stepper
+{
+  public:
+    // register writes
+    void microsteps(uint16_t ms)    { mres = ms; this->written(0); }
+    void rms_current(uint16_t mA)   { current = mA; this->written(1); }
+    void SGTHRS(uint8_t val)        { sgthrs = val; this->written(2); }
+    void TPWMTHRS(uint32_t val)     { tpwmthrs = val; this->written(3); }
+    void TCOOLTHRS(uint32_t val)    { tcoolthrs = val; this->written(4); }
+    void semin(uint8_t val)         { seminval = val; this->written(5); }
+
+    // register reads
+    uint32_t DRV_STATUS(void)       { statusreads++; uartreads++; return drvstatus; }
+    uint16_t SG_RESULT(void)        { sgreads++; uartreads++; return sgresult; }
+
+    // values the driver holds, last written
+    uint16_t mres;
+    uint16_t current;
+    uint8_t  sgthrs;
+    uint32_t tpwmthrs;
+    uint32_t tcoolthrs;
+    uint8_t  seminval;
+
+    // values the driver reports, set by the test
+    uint32_t drvstatus;
+    uint16_t sgresult;
+
+    // UART traffic
+    uint32_t regwrites[6];          // writes per register, in TMCREG_ order
+    uint32_t uartwrites;
+    uint32_t uartreads;
+    uint32_t statusreads;
+    uint32_t sgreads;
+
+  private:
+    void written(int reg)
+    {
+      regwrites[reg]++;
+      uartwrites++;
+    }
+};
+
+#endif // #ifndef TMCStepper_h
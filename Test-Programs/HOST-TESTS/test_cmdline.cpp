@@ -0,0 +1,116 @@
+// ======================================================================
+// test_cmdline.cpp : host test of the TCP command line assembly, cmdline.h
+// ======================================================================
+// Bytes are fed the way tcpclient_readline() gets them from the client, one
+// at a time and split at any point. Checks the assembled commands, the bytes
+// that are ignored, the length limit and the resync after an overlong line.
+
+#include "hosttest.h"
+#include "cmdline.h"
+#include <string>
+#include <vector>
+
+// feed bytes, the complete commands in order
+static std::vector<std::string> feed(CmdLine &cl, const std::string &bytes)
+{
+  std::vector<std::string> cmds;
+  for ( size_t i = 0; i < bytes.size(); i++ )
+  {
+    if ( cl.put(bytes[i]) )
+    {
+      cmds.push_back(cl.line);
+    }
+  }
+  return cmds;
+}
+
+static void test_assembly(void)
+{
+  CmdLine cl = {};
+
+  // one byte per call, complete only at the terminator
+  std::string cmd = ":2812345#";
+  for ( size_t i = 0; i + 1 < cmd.size(); i++ )
+  {
+    CHECK(!cl.put(cmd[i]));
+  }
+  CHECK(cl.put('#'));
+  CHECK(std::string(cl.line) == ":2812345");
+  CHECK(cl.len == 0);
+
+  // pipelined commands split across reads, as TCP may deliver them
+  std::vector<std::string> got = feed(cl, ":00#:0");
+  CHECK(got.size() == 1);
+  CHECK(got[0] == ":00");
+  got = feed(cl, "1#:28");
+  CHECK(got.size() == 1);
+  CHECK(got[0] == ":01");
+  got = feed(cl, "100#");
+  CHECK(got.size() == 1);
+  CHECK(got[0] == ":28100");
+}
+
+static void test_ignored(void)
+{
+  CmdLine cl = {};
+
+  // anything before a start character, line ends and nulls
+  std::vector<std::string> got = feed(cl, std::string("garbage#\r\n:0\r\n0\0#", 18));
+  CHECK(got.size() == 1);
+  CHECK(got[0] == ":00");
+
+  // a terminator with no command started
+  got = feed(cl, "###");
+  CHECK(got.empty());
+
+  // a new start character discards the partial command
+  got = feed(cl, ":28123:01#");
+  CHECK(got.size() == 1);
+  CHECK(got[0] == ":01");
+  CHECK(cl.dropped == 0);
+}
+
+static void test_toolong(void)
+{
+  CmdLine cl = {};
+
+  // the longest command that fits, the start character is stored
+  std::string longest = ":86" + std::string(CMDBUFSIZE - 4, '5');
+  std::vector<std::string> got = feed(cl, longest + "#");
+  CHECK(got.size() == 1);
+  CHECK(got[0] == longest);
+
+  // one more, and many more, are dropped at the terminator, never cut
+  got = feed(cl, longest + "5#");
+  CHECK(got.empty());
+  CHECK(cl.dropped == 1);
+  got = feed(cl, ":86" + std::string(10 * CMDBUFSIZE, '5') + "#");
+  CHECK(got.empty());
+  CHECK(cl.dropped == 2);
+  CHECK(!cl.toolong);
+
+  // the command after it is received
+  got = feed(cl, ":00#");
+  CHECK(got.size() == 1);
+  CHECK(got[0] == ":00");
+
+  // resync: the terminator of an overlong line is lost, the next start character begins a new command
+  got = feed(cl, ":86" + std::string(2 * CMDBUFSIZE, '5') + ":01#:02#");
+  CHECK(got.size() == 2);
+  CHECK((got.size() == 2) && (got[0] == ":01") && (got[1] == ":02"));
+  CHECK(cl.dropped == 2);
+
+  // reset() as on a disconnect, a partial command is not completed by the next client
+  feed(cl, ":281");
+  cl.reset();
+  got = feed(cl, "00#");
+  CHECK(got.empty());
+}
+
+int main(void)
+{
+  test_assembly();
+  test_ignored();
+  test_toolong();
+  return hosttest_result("test_cmdline");
+}
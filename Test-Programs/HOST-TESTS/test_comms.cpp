@@ -0,0 +1,383 @@
+// ======================================================================
+// test_comms.cpp : host bench of the myFP2ESP command receive and dispatch
+// ======================================================================
+// Allocations are counted by a global operator new hook. Commands are fed
+// byte by byte as a client sends them:
+// - before: the String parse of the baseline ESP_Communication(), readStringUntil(),
+//   substring() and toInt(), with String modelled like the ESP32 core 1.0 String,
+//   where every String and every concat holds its own heap buffer
+// - after:  CmdLine and cmd_parse() of cmdline.h, as comms.h uses them now
+// Both make the same reply with snprintf, as SendPaket() does.
+//
+// The dispatch part times the switch of ESP_Communication() against a sorted
+// constexpr table of handlers with a binary search. The command numbers are
+// those of the switch in comms.h, cmdcases.inc is made from it by the Makefile.
+// Timings are printed, not checked, the checks are the allocation counts and
+// that both dispatches pick the same handler.
+
+#include "hosttest.h"
+#include "cmdline.h"
+#include <chrono>
+#include <new>
+
+// ======================================================================
+// ALLOCATION COUNT
+// ======================================================================
+static unsigned long allocations;
+
+static void *counted_malloc(size_t size)
+{
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if ( p == NULL )
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new(size_t size)
+{
+  return counted_malloc(size);
+}
+
+void *operator new[](size_t size)
+{
+  return counted_malloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+  free(p);
+}
+
+// ======================================================================
+// BEFORE : the baseline String parse
+// ======================================================================
+class String
+{
+  public:
+    String(const char *s = "")
+    {
+      this->assign(s, strlen(s));
+    }
+    String(const String &s)
+    {
+      this->assign(s.buf, s.len);
+    }
+    String(String &&s) : buf(s.buf), len(s.len)
+    {
+      s.buf = NULL;
+      s.len = 0;
+    }
+    ~String()
+    {
+      delete[] buf;
+    }
+    String &operator=(const String &s)
+    {
+      if ( this != &s )
+      {
+        delete[] buf;
+        this->assign(s.buf, s.len);
+      }
+      return *this;
+    }
+    String &operator=(String &&s)
+    {
+      delete[] buf;
+      buf = s.buf;
+      len = s.len;
+      s.buf = NULL;
+      s.len = 0;
+      return *this;
+    }
+    // the core reallocs the buffer to the new length on every concat
+    String &operator+=(char c)
+    {
+      char *n = new char[len + 2];
+      memcpy(n, buf, len);
+      n[len++] = c;
+      n[len] = '\0';
+      delete[] buf;
+      buf = n;
+      return *this;
+    }
+    String substring(size_t from, size_t to) const
+    {
+      return ( (from < to) && (to <= len) ) ? String(buf + from, to - from) : String();
+    }
+    long toInt(void) const
+    {
+      return atol(buf);
+    }
+    size_t length(void) const
+    {
+      return len;
+    }
+
+  private:
+    String(const char *s, size_t n)
+    {
+      this->assign(s, n);
+    }
+    void assign(const char *s, size_t n)
+    {
+      buf = new char[n + 1];
+      memcpy(buf, s, n);
+      buf[n] = '\0';
+      len = n;
+    }
+    char   *buf;
+    size_t len;
+};
+
+static const char brdname_c[] = "PRO2ESP32DRV8825";
+static String brdname(brdname_c);
+static const char *bytes;                       // the client stream being read
+
+// Stream::readStringUntil()
+static String readStringUntil(char terminator)
+{
+  String ret;
+  while ( (*bytes != '\0') && (*bytes != terminator) )
+  {
+    ret += *bytes++;
+  }
+  if ( *bytes == terminator )
+  {
+    bytes++;
+  }
+  return ret;
+}
+
+// the start of the baseline ESP_Communication() for one command, returns the reply length
+static int before_command(char *reply, size_t size)
+{
+  String receiveString = "";
+  String WorkString = "";
+  long paramval = 0;
+  String drvbrd = brdname;
+
+  receiveString = readStringUntil(EOFSTR);
+  receiveString += EOFSTR;
+  String cmdstr = receiveString.substring(1, 3);
+  byte cmdval = cmdstr.toInt();
+  if ( receiveString.length() > 4 )                // set command, as the cases with a parameter
+  {
+    WorkString = receiveString.substring(3, receiveString.length() - 1);
+    paramval = WorkString.toInt();
+  }
+  return snprintf(reply, size, "%c%ld%c", 'P', (long) cmdval + paramval + (long) drvbrd.length(), EOFSTR);
+}
+
+// ======================================================================
+// AFTER : CmdLine and cmd_parse()
+// ======================================================================
+static CmdLine cl;
+
+static int after_command(char *reply, size_t size)
+{
+  while ( *bytes != '\0' )
+  {
+    if ( cl.put(*bytes++) )
+    {
+      const char *param;
+      byte cmdval = cmd_parse(cl.line, strlen(cl.line), &param);
+      long paramval = atol(param);
+      return snprintf(reply, size, "%c%ld%c", 'P', (long) cmdval + paramval + (long) strlen(brdname_c), EOFSTR);
+    }
+  }
+  return 0;
+}
+
+// ======================================================================
+// RECEIVE BENCH
+// ======================================================================
+// a polling client, position, moving and temperature, with a move and a few set commands
+static const char *mix[] = { ":00#", ":01#", ":06#", ":00#", ":01#", ":0512345#", ":00#", ":1501#", ":2810#", ":4820#" };
+#define MIXLEN (sizeof(mix) / sizeof(mix[0]))
+#define COMMANDS 200000
+
+static double now(void)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void bench_receive(const char *name, int (*command)(char *, size_t), double &persec, double &allocs)
+{
+  char reply[32];
+  unsigned long replies = 0;
+  unsigned long a = allocations;
+  double t = now();
+  for ( int i = 0; i < COMMANDS; i++ )
+  {
+    bytes = mix[i % MIXLEN];
+    replies += ( command(reply, sizeof(reply)) > 0 ) ? 1 : 0;
+  }
+  t = now() - t;
+  allocs = (double) (allocations - a) / COMMANDS;
+  persec = COMMANDS / t;
+  CHECK(replies == COMMANDS);
+  printf("test_comms: %-6s %10.0f commands/s, %5.2f allocations/command\n", name, persec, allocs);
+}
+
+static void test_receive(void)
+{
+  // both read the same command and parameter
+  char r1[32];
+  char r2[32];
+  for ( size_t i = 0; i < MIXLEN; i++ )
+  {
+    bytes = mix[i];
+    before_command(r1, sizeof(r1));
+    bytes = mix[i];
+    after_command(r2, sizeof(r2));
+    CHECK(strcmp(r1, r2) == 0);
+  }
+
+  double before, beforeallocs, after, afterallocs;
+  bench_receive("before", before_command, before, beforeallocs);
+  bench_receive("after", after_command, after, afterallocs);
+  CHECK(beforeallocs >= 5);                     // the hook sees the String allocations
+  CHECK(afterallocs == 0);                      // no heap allocation per command
+}
+
+// ======================================================================
+// DISPATCH BENCH
+// ======================================================================
+static volatile long sink;
+
+template <int N> __attribute__((noinline)) void cmdhandler(const char *param)
+{
+  sink = sink + N + param[0];
+}
+
+static void nocommand(const char *param)
+{
+  sink = sink - 1 - param[0];
+}
+
+// the switch of ESP_Communication()
+__attribute__((noinline)) static void dispatch_switch(byte cmdval, const char *param)
+{
+  switch ( cmdval )
+  {
+#define CMDCASE(n) case n: cmdhandler<n>(param); break;
+#include "cmdcases.inc"
+#undef CMDCASE
+    default:
+      nocommand(param);
+      break;
+  }
+}
+
+// a constexpr table sorted by command number, binary search
+struct CmdHandler
+{
+  byte cmdval;
+  void (*handler)(const char *);
+};
+
+static constexpr CmdHandler cmdtable[] =
+{
+#define CMDCASE(n) { n, cmdhandler<n> },
+#include "cmdcases.inc"
+#undef CMDCASE
+};
+#define CMDTABLELEN (sizeof(cmdtable) / sizeof(cmdtable[0]))
+
+constexpr bool cmdtable_sorted(size_t i)
+{
+  return ( i + 1 >= CMDTABLELEN ) ? true : ( (cmdtable[i].cmdval < cmdtable[i + 1].cmdval) && cmdtable_sorted(i + 1) );
+}
+static_assert(cmdtable_sorted(0), "cmdtable is not sorted by command number");
+
+__attribute__((noinline)) static void dispatch_table(byte cmdval, const char *param)
+{
+  size_t lo = 0;
+  size_t hi = CMDTABLELEN;
+  while ( lo < hi )
+  {
+    size_t mid = (lo + hi) / 2;
+    if ( cmdtable[mid].cmdval < cmdval )
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  if ( (lo < CMDTABLELEN) && (cmdtable[lo].cmdval == cmdval) )
+  {
+    cmdtable[lo].handler(param);
+  }
+  else
+  {
+    nocommand(param);
+  }
+}
+
+#define DISPATCHES 20000000
+
+static double bench_dispatch(const char *name, void (*dispatch)(byte, const char *), const byte *cmds, size_t n)
+{
+  double t = now();
+  for ( int i = 0; i < DISPATCHES; i++ )
+  {
+    dispatch(cmds[i % n], "1");
+  }
+  t = now() - t;
+  printf("test_comms: %-6s %6.2f ns/dispatch\n", name, t * 1e9 / DISPATCHES);
+  return t;
+}
+
+static void test_dispatch(void)
+{
+  CHECK(CMDTABLELEN >= 90);
+
+  // every command number, and some that are none, go to the same handler
+  for ( int c = 0; c < 256; c++ )
+  {
+    sink = 0;
+    dispatch_switch((byte) c, "1");
+    long s = sink;
+    sink = 0;
+    dispatch_table((byte) c, "1");
+    CHECK(sink == s);
+  }
+
+  // commands in a pseudo random order, so the branch predictor does not learn them
+  static byte cmds[4096];
+  uint32_t r = 12345;
+  for ( size_t i = 0; i < sizeof(cmds); i++ )
+  {
+    r = r * 1103515245 + 12345;
+    cmds[i] = cmdtable[(r >> 16) % CMDTABLELEN].cmdval;
+  }
+  bench_dispatch("switch", dispatch_switch, cmds, sizeof(cmds));
+  bench_dispatch("table", dispatch_table, cmds, sizeof(cmds));
+}
+
+int main(void)
+{
+  test_receive();
+  test_dispatch();
+  return hosttest_result("test_comms");
+}
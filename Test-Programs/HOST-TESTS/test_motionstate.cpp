@@ -0,0 +1,176 @@
+// ======================================================================
+// test_motionstate.cpp : host stress test of the motion state seqlock, motionstate.h
+// ======================================================================
+// One writer thread publishes motion states the way the timer ISR and the
+// motion loop do, while reader threads take snapshots. Every state the writer
+// publishes has fields that depend on each other, so a torn snapshot, mixing
+// fields of two updates, is seen by the readers.
+// On a single core the threads rarely interleave inside a snapshot, so a second
+// run publishes from a timer signal that interrupts the reader, like the step
+// ISR interrupts a reader on the ESP8266.
+
+#include "hosttest.h"
+#include "motionstate.h"
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#define UPDATES   4000000UL                   // updates from the writer
+#define READERS   3
+#define SETEVERY  64                          // one set() of all fields every SETEVERY updates
+#define TARGETOFS 12345UL
+#define SIGNALS   20000UL                     // updates from the timer signal
+
+MotionSeqlock lock;
+volatile bool writing;
+
+struct ReaderResult
+{
+  unsigned long reads;
+  unsigned long torn;
+  unsigned long backwards;                    // position older than an earlier snapshot
+};
+
+// fields of an update() of position k
+static bool valid_update(const MotionState &ms)
+{
+  return (ms.stepcount == (uint32_t) ~ms.position) && (ms.stepdir == ((ms.position & 1) != 0));
+}
+
+// fields of a set(), target and moving belong together
+static bool valid_set(const MotionState &ms)
+{
+  return (ms.moving == (byte) ((ms.target - TARGETOFS) & 0x7f));
+}
+
+// publish the state of update k
+static void publish(unsigned long k)
+{
+  if ( (k % SETEVERY) == 0 )
+  {
+    MotionState ms;
+    ms.position  = k;
+    ms.target    = k + TARGETOFS;
+    ms.stepcount = (uint32_t) ~k;
+    ms.stepdir   = (k & 1) != 0;
+    ms.moving    = (byte) (k & 0x7f);
+    lock.set(ms);
+  }
+  else
+  {
+    lock.update(k, (uint32_t) ~k, (k & 1) != 0);
+  }
+}
+
+static void *writer(void *)
+{
+  for ( unsigned long k = 1; k <= UPDATES; k++ )
+  {
+    publish(k);
+  }
+  writing = false;
+  return NULL;
+}
+
+volatile unsigned long signalk;
+
+static void onsignal(int)
+{
+  signalk = signalk + 1;
+  publish(signalk);
+}
+
+static void *reader(void *arg)
+{
+  ReaderResult *r = (ReaderResult *) arg;
+  unsigned long last = 0;
+  do
+  {
+    MotionState ms;
+    lock.read(ms);
+    r->reads++;
+    if ( !valid_update(ms) || !valid_set(ms) )
+    {
+      r->torn++;
+    }
+    if ( ms.position < last )
+    {
+      r->backwards++;
+    }
+    last = ms.position;
+  } while ( writing );
+  return NULL;
+}
+
+int main(void)
+{
+  MotionState init;
+  init.position  = 0;
+  init.target    = TARGETOFS;
+  init.stepcount = (uint32_t) ~0UL;
+  init.stepdir   = false;
+  init.moving    = 0;
+  lock.set(init);
+
+  // the initial state is read back as it was set
+  MotionState ms;
+  lock.read(ms);
+  CHECK((ms.position == 0) && (ms.target == TARGETOFS) && valid_update(ms) && valid_set(ms));
+
+  writing = true;
+  pthread_t w;
+  pthread_t rd[READERS];
+  ReaderResult res[READERS] = {};
+  for ( int i = 0; i < READERS; i++ )
+  {
+    pthread_create(&rd[i], NULL, reader, &res[i]);
+  }
+  pthread_create(&w, NULL, writer, NULL);
+  pthread_join(w, NULL);
+  unsigned long reads = 0;
+  for ( int i = 0; i < READERS; i++ )
+  {
+    pthread_join(rd[i], NULL);
+    CHECK(res[i].torn == 0);
+    CHECK(res[i].backwards == 0);
+    reads += res[i].reads;
+  }
+  CHECK(reads > READERS);
+
+  // the last update is the one readers see when the writer is done
+  lock.read(ms);
+  CHECK((ms.position == UPDATES) && valid_update(ms));
+  printf("test_motionstate: %lu updates, %lu snapshots\n", UPDATES, reads);
+
+  // writer interrupts the reader
+  lock.set(init);
+  signal(SIGALRM, onsignal);
+  struct itimerval tv;
+  tv.it_interval.tv_sec  = 0;
+  tv.it_interval.tv_usec = 20;
+  tv.it_value            = tv.it_interval;
+  setitimer(ITIMER_REAL, &tv, NULL);
+  ReaderResult sr = {};
+  unsigned long last = 0;
+  while ( signalk < SIGNALS )
+  {
+    lock.read(ms);
+    sr.reads++;
+    if ( !valid_update(ms) || !valid_set(ms) )
+    {
+      sr.torn++;
+    }
+    if ( ms.position < last )
+    {
+      sr.backwards++;
+    }
+    last = ms.position;
+  }
+  tv.it_interval.tv_usec = 0;
+  tv.it_value            = tv.it_interval;
+  setitimer(ITIMER_REAL, &tv, NULL);
+  CHECK(sr.torn == 0);
+  CHECK(sr.backwards == 0);
+  printf("test_motionstate: %lu signal updates, %lu snapshots\n", SIGNALS, sr.reads);
+  return hosttest_result("test_motionstate");
+}
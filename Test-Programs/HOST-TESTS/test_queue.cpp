@@ -0,0 +1,109 @@
+// ======================================================================
+// test_queue.cpp : host test of the serial command queue, ESPQueue.h
+// ======================================================================
+// Commands are fed a character at a time the way processserial() does, then
+// popped like the comms loop. Checks the order, a full queue, and that a
+// command longer than a slot is dropped, not queued cut, and the next one is
+// received.
+
+#include "hosttest.h"
+#include "ESPQueue.h"
+#include <string>
+
+Queue queue;
+
+static bool send(const std::string &cmd)
+{
+  queue.start();
+  for ( size_t i = 0; i < cmd.size(); i++ )
+  {
+    queue.put(cmd[i]);
+  }
+  return queue.push();
+}
+
+static std::string pop(void)
+{
+  char buf[CMDBUFSIZE];
+  size_t n = queue.pop(buf, sizeof(buf));
+  return std::string(buf, n);
+}
+
+static void test_order(void)
+{
+  CHECK(queue.count() == 0);
+  CHECK(pop() == "");
+  CHECK(send("00"));
+  CHECK(send("2812345"));
+  CHECK(queue.count() == 2);
+  CHECK(pop() == "00");
+  CHECK(pop() == "2812345");
+  CHECK(queue.count() == 0);
+
+  // a short buffer gets the start of the command
+  CHECK(send("2812345"));
+  char buf[4];
+  CHECK(queue.pop(buf, sizeof(buf)) == 3);
+  CHECK(std::string(buf) == "281");
+}
+
+static void test_full(void)
+{
+  for ( int i = 0; i < QUEUELENGTH; i++ )
+  {
+    CHECK(send(std::string("0") + char('0' + i)));
+  }
+  CHECK(!send("99"));
+  CHECK(queue.overflows() == 1);
+  CHECK(queue.count() == QUEUELENGTH);
+  CHECK(pop() == "00");
+  CHECK(send("98"));
+  for ( int i = 1; i < QUEUELENGTH; i++ )
+  {
+    CHECK(pop() == std::string("0") + char('0' + i));
+  }
+  CHECK(pop() == "98");
+  CHECK(queue.count() == 0);
+
+  CHECK(send("01"));
+  queue.clear();
+  CHECK(queue.count() == 0);
+}
+
+static void test_toolong(void)
+{
+  // the longest command that fits a slot
+  std::string longest = "86" + std::string(CMDBUFSIZE - 3, '5');
+  CHECK(send(longest));
+  CHECK(pop() == longest);
+  CHECK(queue.toolong() == 0);
+
+  // one more character, and much longer, are dropped whole
+  CHECK(!send(longest + "5"));
+  CHECK(!send("86" + std::string(3 * CMDBUFSIZE, '5')));
+  CHECK(queue.toolong() == 2);
+  CHECK(queue.count() == 0);
+
+  // the next command is received
+  CHECK(send("00"));
+  CHECK(pop() == "00");
+
+  // a new start character ends the long command, the rest is the next command
+  queue.start();
+  for ( int i = 0; i < CMDBUFSIZE + 10; i++ )
+  {
+    queue.put('5');
+  }
+  CHECK(send("01"));
+  CHECK(pop() == "01");
+  CHECK(queue.toolong() == 2);
+  CHECK(queue.overflows() == 1);
+}
+
+int main(void)
+{
+  test_order();
+  test_full();
+  test_toolong();
+  return hosttest_result("test_queue");
+}
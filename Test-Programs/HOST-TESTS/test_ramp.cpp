@@ -0,0 +1,363 @@
+// ======================================================================
+// test_ramp.cpp : host test of the step interval ramp, ramp.h
+// ======================================================================
+// Runs moves through StepRamp the way the timer ISR does and checks the
+// 24.8 fixed point recurrence: ramp length, symmetry, cruise interval and
+// that short moves never underflow the ramp step count.
+
+#include "hosttest.h"
+#include "ramp.h"
+#include <vector>
+
+#define CMIN      500                         // cruise interval [uS], 2000 steps/s
+#define ACCEL     2000                        // steps/s/s, ramp of 2000^2 / (2 * 2000) = 1000 steps
+#define RAMPSTEPS 1000
+
+// run a move of steps, returns the interval before each step. Like the ISR, the step is taken,
+// stepcount is decremented, then next() gives the interval to the next step
+static std::vector<uint32_t> runmove(StepRamp &r, uint32_t first, uint32_t steps, uint32_t *maxn = NULL)
+{
+  std::vector<uint32_t> iv;
+  uint32_t cur = first;
+  uint32_t left = steps;
+  while ( left > 0 )
+  {
+    iv.push_back(cur);
+    left--;
+    uint32_t us = r.next(left);
+    if ( us != 0 )
+    {
+      cur = us;
+    }
+    if ( (maxn != NULL) && (r.n > *maxn) )
+    {
+      *maxn = r.n;
+    }
+  }
+  return iv;
+}
+
+static double relerr(double a, double b)
+{
+  return fabs(a - b) / b;
+}
+
+static void test_trapezoid_long(void)
+{
+  StepRamp r;
+  r.approach_steps = 0;
+  uint32_t c0 = r.setup(CMIN, ACCEL, PROFILE_TRAPEZOID);
+  CHECK(r.mode == RAMP_TRAPEZOID);
+  CHECK(relerr(c0, 0.676 * sqrt(2.0 / ACCEL) * 1000000.0) < 0.001);
+  CHECK((r.interval >> RAMPSHIFT) == c0);
+  CHECK((r.mininterval >> RAMPSHIFT) == CMIN);
+
+  std::vector<uint32_t> iv = runmove(r, c0, 10000);
+  CHECK(iv.size() == 10000);
+  CHECK(r.n == 0);                            // the ramp is back at the start when the move ends
+
+  // accelerate, cruise, decelerate
+  size_t accel = 0;
+  while ( (accel < iv.size()) && (iv[accel] > CMIN) )
+  {
+    accel++;
+  }
+  size_t decel = 0;
+  while ( (decel < iv.size()) && (iv[iv.size() - 1 - decel] > CMIN) )
+  {
+    decel++;
+  }
+  CHECK(relerr(accel, RAMPSTEPS) < 0.02);
+  CHECK((accel > decel ? accel - decel : decel - accel) <= 1);
+  bool monotonic = true;
+  for ( size_t i = 1; i < accel; i++ )
+  {
+    monotonic = monotonic && (iv[i] <= iv[i - 1]);
+  }
+  for ( size_t i = iv.size() - decel; i < iv.size(); i++ )
+  {
+    monotonic = monotonic && (iv[i] >= iv[i - 1]);
+  }
+  CHECK(monotonic);
+  bool cruise = true;
+  for ( size_t i = accel; i < iv.size() - decel; i++ )
+  {
+    cruise = cruise && (iv[i] == CMIN);
+  }
+  CHECK(cruise);
+
+  // deceleration mirrors the acceleration
+  double worst = 0.0;
+  for ( size_t i = 0; i < accel; i++ )
+  {
+    double e = relerr(iv[iv.size() - 1 - i], iv[i]);
+    worst = ( e > worst ) ? e : worst;
+  }
+  CHECK(worst < 0.05);
+  CHECK(relerr(iv.back(), c0) < 0.05);
+}
+
+static void test_trapezoid_short(void)
+{
+  // moves shorter than two ramps never reach cruise, and must stop without the step count wrapping
+  for ( uint32_t steps = 1; steps <= 2 * RAMPSTEPS + 10; steps += ( steps < 64 ) ? 1 : 37 )
+  {
+    StepRamp r;
+    r.approach_steps = 0;
+    uint32_t c0 = r.setup(CMIN, ACCEL, PROFILE_TRAPEZOID);
+    uint32_t maxn = 0;
+    std::vector<uint32_t> iv = runmove(r, c0, steps, &maxn);
+    bool bounded = true;
+    size_t fastest = 0;
+    for ( size_t i = 0; i < iv.size(); i++ )
+    {
+      bounded = bounded && (iv[i] >= CMIN) && (iv[i] <= c0 + c0 / 10);
+      fastest = ( iv[i] < iv[fastest] ) ? i : fastest;
+    }
+    CHECK(bounded);
+    CHECK(maxn <= (steps + 1) / 2);           // at most half the move accelerates
+    CHECK(r.n == 0);
+    if ( steps > 2 )
+    {
+      CHECK((fastest + 2 >= steps / 2) && (fastest <= steps / 2 + 1));
+    }
+  }
+}
+
+static void test_noramp(void)
+{
+  StepRamp r;
+  r.approach_steps = 0;
+  CHECK(r.setup(CMIN, 0, PROFILE_TRAPEZOID) == CMIN);
+  CHECK(r.mode == RAMP_NONE);
+  CHECK(r.stopsteps() == 0);
+  CHECK(r.next(10) == 0);
+
+  // the first interval of a very high acceleration is already faster than cruise
+  CHECK(r.setup(CMIN, 100000000UL, PROFILE_TRAPEZOID) == CMIN);
+  CHECK(r.mode == RAMP_NONE);
+}
+
+static void test_scurve(void)
+{
+  bool table = (scurve_table[SCURVESIZE] == 256);
+  for ( int i = 1; i <= SCURVESIZE; i++ )
+  {
+    table = table && (scurve_table[i] <= scurve_table[i - 1]);
+  }
+  CHECK(table);
+  CHECK(scurve_table[0] == 16 * 256);         // starts at SCURVEVMIN of the cruise speed
+
+  StepRamp r;
+  r.approach_steps = 0;
+  uint32_t c0 = r.setup(CMIN, ACCEL, PROFILE_SCURVE);
+  CHECK(r.mode == RAMP_SCURVE);
+  CHECK(r.scurve_steps == RAMPSTEPS);
+  CHECK(c0 == ((uint32_t) CMIN * scurve_table[0]) >> 8);
+
+  std::vector<uint32_t> iv = runmove(r, c0, 5000);
+  CHECK(r.n == 0);
+  size_t accel = 0;
+  while ( iv[accel] > CMIN )
+  {
+    accel++;
+  }
+  CHECK((accel >= RAMPSTEPS * 9 / 10) && (accel <= RAMPSTEPS)); // the table reaches 256 just before its end
+  bool mirror = true;
+  for ( size_t i = 0; i < accel; i++ )
+  {
+    mirror = mirror && (iv[iv.size() - 1 - i] == iv[i]);
+  }
+  CHECK(mirror);
+}
+
+// the slowest cruise that still ramps, at the lowest acceleration. The S-curve start interval is
+// 16 times cruise, more than 32 bits hold before the multiply is shifted down
+static void test_scurve_slow(void)
+{
+  StepRamp r;
+  r.approach_steps = 0;
+  uint32_t start = r.setup(RAMPMAXINTERVAL, 1, PROFILE_TRAPEZOID);
+  CHECK(r.mode == RAMP_NONE);                 // a cruise slower than any ramp start does not ramp
+  CHECK(start == RAMPMAXINTERVAL);
+
+  float cmin = 0.676 * sqrt(2.0) * 1000000.0 - 1.0;
+  uint32_t c0 = r.setup(cmin, 1, PROFILE_SCURVE);
+  CHECK(r.mode == RAMP_SCURVE);
+  CHECK(c0 == (uint32_t) (((uint64_t) r.scurve_cruise * scurve_table[0]) >> 8));
+  CHECK(c0 > r.scurve_cruise);
+
+  std::vector<uint32_t> iv = runmove(r, c0, 8);
+  CHECK(r.n == 0);
+  CHECK((iv.front() == c0) && (iv.back() == c0));
+  bool bounded = true;
+  for ( size_t i = 0; i < iv.size(); i++ )
+  {
+    bounded = bounded && (iv[i] >= r.scurve_cruise) && (iv[i] <= c0);
+  }
+  CHECK(bounded);
+
+  // the last step of a deceleration at a cruise above 1048575 uS, where a 32 bit product wraps
+  r.scurve_cruise = 2000000;
+  r.n = 1;
+  CHECK(r.next(0) == 16 * 2000000);
+}
+
+static void test_cruise(void)
+{
+  CHECK(ramp_cruise(700, 0, 100, FAST) == 700.0);   // no max speed, interval of the motorspeed
+  CHECK(ramp_cruise(700, 1000, 100, FAST) == 1000.0);
+  CHECK(ramp_cruise(700, 1000, 100, MED) == 2000.0);
+  CHECK(ramp_cruise(700, 1000, 100, SLOW) == 3000.0);
+  CHECK(ramp_cruise(700, 50000, 100, FAST) == 100.0); // never faster than the board
+  CHECK(ramp_cruise(0, 0, 0, FAST) == 1.0);
+}
+
+// move queue segments and homing moves pass their own motorspeed, the cruise of the ramped move follows it
+static void test_movespeeds(void)
+{
+  const byte     speeds[3] = { SLOW, MED, FAST };
+  const uint32_t cruise[3] = { 3000, 2000, 1000 };
+  for ( int i = 0; i < 3; i++ )
+  {
+    StepRamp r;
+    r.approach_steps = 0;
+    uint32_t c0 = r.setup(ramp_cruise(700, 1000, 100, speeds[i]), ACCEL, PROFILE_TRAPEZOID);
+    std::vector<uint32_t> iv = runmove(r, c0, 2000);
+    CHECK(iv[1000] == cruise[i]);
+  }
+}
+
+static void test_approach(void)
+{
+  StepRamp r;
+  r.approach_steps    = 100;
+  r.approach_interval = 3 * CMIN;
+  uint32_t c0 = r.setup(CMIN, ACCEL, PROFILE_TRAPEZOID);
+  std::vector<uint32_t> iv = runmove(r, c0, 5000);
+  bool slow = true;
+  for ( size_t i = iv.size() - 100; i < iv.size(); i++ )
+  {
+    slow = slow && (iv[i] == 3 * CMIN);
+  }
+  CHECK(slow);
+  CHECK(r.approach_steps == 0);
+  CHECK(r.mode == RAMP_NONE);
+}
+
+// from the end of cruise through the approach the intervals never get shorter, and the deceleration never
+// gets slower than the approach. returns the index where the deceleration starts
+static size_t check_decel(const std::vector<uint32_t> &iv, uint32_t approach, uint32_t approachsteps)
+{
+  size_t fastest = 0;
+  for ( size_t i = 0; i < iv.size(); i++ )
+  {
+    fastest = ( iv[i] <= iv[fastest] ) ? i : fastest;   // last step at the top speed
+  }
+  bool monotonic = true;
+  bool bounded = true;
+  for ( size_t i = fastest + 1; i < iv.size(); i++ )
+  {
+    monotonic = monotonic && (iv[i] >= iv[i - 1]);
+    bounded = bounded && (iv[i] <= approach);
+  }
+  CHECK(monotonic);
+  CHECK(bounded);
+  bool slow = true;
+  for ( size_t i = iv.size() - approachsteps; i < iv.size(); i++ )
+  {
+    slow = slow && (iv[i] == approach);
+  }
+  CHECK(slow);
+  return fastest;
+}
+
+// the ramp decelerates to the approach speed, not to its start interval c0, which is slower than the approach
+static void test_approach_decel(void)
+{
+  const byte profiles[2] = { PROFILE_TRAPEZOID, PROFILE_SCURVE };
+  for ( int p = 0; p < 2; p++ )
+  {
+    StepRamp r;
+    r.approach_steps    = 100;
+    r.approach_interval = 3 * CMIN;
+    uint32_t c0 = r.setup(CMIN, ACCEL, profiles[p]);
+    CHECK(c0 > 3 * CMIN);
+    CHECK(r.approach_n > 0);
+    std::vector<uint32_t> iv = runmove(r, c0, 5000);
+    size_t decel = check_decel(iv, 3 * CMIN, 100);
+    // the ramp down to the approach is shorter than the full ramp
+    CHECK(iv.size() - 100 - decel < RAMPSTEPS);
+    CHECK(iv.size() - 100 - decel > RAMPSTEPS / 2);
+    CHECK(iv[iv.size() - 101] >= 3 * CMIN * 9 / 10);  // the last ramp step is close to the approach speed
+  }
+
+  // an approach slower than the ramp start follows a full deceleration
+  StepRamp r;
+  r.approach_steps    = 50;
+  r.approach_interval = 30000;
+  uint32_t c0 = r.setup(CMIN, ACCEL, PROFILE_TRAPEZOID);
+  CHECK(c0 < 30000);
+  CHECK(r.approach_n == 0);
+  std::vector<uint32_t> iv = runmove(r, c0, 5000);
+  check_decel(iv, 30000, 50);
+
+  // an approach faster than cruise is slowed down to cruise
+  r.approach_steps    = 50;
+  r.approach_interval = CMIN / 2;
+  c0 = r.setup(CMIN, ACCEL, PROFILE_TRAPEZOID);
+  CHECK(r.approach_interval == CMIN);
+  iv = runmove(r, c0, 5000);
+  check_decel(iv, CMIN, 50);
+}
+
+// a retarget at cruise leaves just the stopping distance, the ramp decelerates into the approach steps
+static void test_approach_retarget(void)
+{
+  StepRamp r;
+  r.approach_steps    = 100;
+  r.approach_interval = 3 * CMIN;
+  uint32_t cur = r.setup(CMIN, ACCEL, PROFILE_TRAPEZOID);
+  std::vector<uint32_t> iv;
+  uint32_t left = 10000;
+  while ( left > 7000 )
+  {
+    iv.push_back(cur);
+    left--;
+    uint32_t us = r.next(left);
+    cur = ( us != 0 ) ? us : cur;
+  }
+  left = r.stopsteps();                       // retargetmove() keeps the approach when steps >= stopsteps
+  while ( left > 0 )
+  {
+    iv.push_back(cur);
+    left--;
+    uint32_t us = r.next(left);
+    cur = ( us != 0 ) ? us : cur;
+  }
+  bool monotonic = true;
+  bool bounded = true;
+  for ( size_t i = 3001; i < iv.size(); i++ )
+  {
+    monotonic = monotonic && (iv[i] >= iv[i - 1]);
+    bounded = bounded && (iv[i] <= 3 * CMIN);
+  }
+  CHECK(monotonic);
+  CHECK(bounded);
+  CHECK(iv.back() == 3 * CMIN);
+}
+
+int main(void)
+{
+  test_trapezoid_long();
+  test_trapezoid_short();
+  test_noramp();
+  test_scurve();
+  test_scurve_slow();
+  test_cruise();
+  test_movespeeds();
+  test_approach();
+  test_approach_decel();
+  test_approach_retarget();
+  return hosttest_result("test_ramp");
+}
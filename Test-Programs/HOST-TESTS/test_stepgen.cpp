@@ -0,0 +1,269 @@
+// ======================================================================
+// test_stepgen.cpp : host test of hardware step generator moves, stepgen.h
+// ======================================================================
+// FakeStepGenerator implements the StepGenerator interface like the RMT does:
+// pulses are committed to a memory of FAKE_MEM pulses ahead of the pin, and
+// settotal() cannot take back pulses already committed. The tests drive moves
+// the way DriverBoard does and check position, steps left and retargeting
+// from StepGenMove.
+
+#include "hosttest.h"
+#include "stepgen.h"
+
+#define FAKE_MEM 64                           // pulses the fake can commit ahead, like one RMT memory block
+
+class FakeStepGenerator : public StepGenerator
+{
+  public:
+    bool begin(uint8_t pin, void (*done)(void))
+    {
+      steppin = pin;
+      ondone  = done;
+      return true;
+    }
+
+    void start(uint32_t steps, uint32_t intervalus)
+    {
+      total     = steps;
+      interval  = intervalus;
+      sent      = 0;
+      committed = 0;
+      ended     = false;
+      sending   = true;
+      starts++;
+      this->refill();
+    }
+
+    uint32_t settotal(uint32_t steps)
+    {
+      if ( ended || (steps < committed) )
+      {
+        steps = committed;
+      }
+      total = steps;
+      return steps;
+    }
+
+    uint32_t stepsdone(void)
+    {
+      return sent;
+    }
+
+    bool busy(void)
+    {
+      return sending;
+    }
+
+    void end(void)
+    {
+    }
+
+    // send up to n pulses on the pin, returns the pulses sent
+    uint32_t pulse(uint32_t n)
+    {
+      uint32_t k = 0;
+      while ( (k < n) && sending )
+      {
+        if ( sent < committed )
+        {
+          sent++;
+          k++;
+          this->refill();
+        }
+        if ( (sent == committed) && ended )
+        {
+          sending = false;
+          if ( ondone != NULL )
+          {
+            ondone();
+          }
+        }
+      }
+      return k;
+    }
+
+    uint32_t committed;
+    uint32_t interval;
+    int starts;
+
+  private:
+    // the translator: commit pulses while there is room, fewer than wanted ends the transmission
+    void refill(void)
+    {
+      if ( ended )
+      {
+        return;
+      }
+      uint32_t wanted = sent + FAKE_MEM - committed;
+      uint32_t left = total - committed;
+      uint32_t n = ( left < wanted ) ? left : wanted;
+      committed += n;
+      ended = ( n < wanted );
+    }
+
+    uint8_t steppin;
+    void (*ondone)(void);
+    uint32_t total;
+    uint32_t sent;
+    bool ended;
+    bool sending;
+};
+
+FakeStepGenerator fake;
+StepGenerator *stepgen = &fake;
+StepGenMove hwmv;
+int donecalls;
+
+void stepgen_done(void)
+{
+  donecalls++;
+}
+
+// run the move to its end, like end_move() waiting for the generator after a halt
+static void finish(void)
+{
+  while ( stepgen->busy() )
+  {
+    fake.pulse(1);
+  }
+}
+
+// as DriverBoard::retargetmove(), true if the move now ends at target
+static bool retarget(unsigned long target)
+{
+  uint32_t newtotal = hwmv.retarget(stepgen->stepsdone(), target);
+  uint32_t total = stepgen->settotal(newtotal);
+  hwmv.total = total;
+  return (newtotal != 0) && (total == newtotal);
+}
+
+static void startmove(unsigned long pos, uint32_t backlash, uint32_t steps, bool dir, uint32_t weight)
+{
+  donecalls = 0;
+  hwmv.start(pos, backlash, steps, dir, weight);
+  stepgen->start(hwmv.total, 500);
+}
+
+static void test_move(void)
+{
+  startmove(1000, 20, 500, moving_out, 1);
+  CHECK(fake.interval == 500);
+  CHECK(hwmv.total == 520);
+  CHECK(fake.committed == FAKE_MEM);
+
+  // backlash pulses first, the focuser does not move
+  fake.pulse(10);
+  uint32_t done = stepgen->stepsdone();
+  CHECK(hwmv.position(done) == 1000);
+  CHECK(hwmv.backlashleft(done) == 10);
+  CHECK(hwmv.stepsleft(done) == 510);
+
+  fake.pulse(40);
+  done = stepgen->stepsdone();
+  CHECK(hwmv.position(done) == 1030);
+  CHECK(hwmv.backlashleft(done) == 0);
+  CHECK(hwmv.stepsleft(done) == 470);
+
+  finish();
+  done = stepgen->stepsdone();
+  CHECK(done == 520);
+  CHECK(hwmv.position(done) == 1500);
+  CHECK(hwmv.stepsleft(done) == 0);
+  CHECK(donecalls == 1);
+
+  // moving in
+  startmove(1000, 0, 300, moving_in, 1);
+  fake.pulse(100);
+  CHECK(hwmv.position(stepgen->stepsdone()) == 900);
+  finish();
+  CHECK(hwmv.position(stepgen->stepsdone()) == 700);
+  CHECK(donecalls == 1);
+}
+
+static void test_retarget(void)
+{
+  // further in the same direction, the move is extended
+  startmove(1000, 20, 500, moving_out, 1);
+  fake.pulse(100);
+  CHECK(retarget(1800));
+  CHECK(hwmv.stepsleft(stepgen->stepsdone()) == 720);
+  finish();
+  CHECK(hwmv.position(stepgen->stepsdone()) == 1800);
+  CHECK(donecalls == 1);
+
+  // closer, but not closer than the pulses already committed
+  startmove(1000, 20, 500, moving_out, 1);
+  fake.pulse(100);
+  CHECK(retarget(1200));
+  finish();
+  CHECK(hwmv.position(stepgen->stepsdone()) == 1200);
+
+  // closer than the committed pulses, the move ends after them and the caller starts a new one
+  startmove(1000, 20, 500, moving_out, 1);
+  fake.pulse(100);
+  uint32_t committed = fake.committed;
+  CHECK(!retarget(1090));
+  CHECK(hwmv.total == committed);
+  finish();
+  uint32_t done = stepgen->stepsdone();
+  CHECK(done == committed);
+  CHECK(hwmv.position(done) == 1000 + committed - 20);
+  CHECK(hwmv.stepsleft(done) == 0);
+
+  // behind the focuser, or already there, stop
+  startmove(1000, 0, 500, moving_out, 1);
+  fake.pulse(100);
+  CHECK(hwmv.retarget(stepgen->stepsdone(), 1050) == 0);
+  CHECK(hwmv.retarget(stepgen->stepsdone(), 1100) == 0);
+  CHECK(!retarget(900));
+  finish();
+  CHECK(hwmv.position(stepgen->stepsdone()) == 1000 + fake.committed);
+
+  // backlash still to send is kept in the new total
+  startmove(1000, 20, 500, moving_out, 1);
+  fake.pulse(5);
+  CHECK(hwmv.retarget(stepgen->stepsdone(), 1300) == 5 + 15 + 300);
+}
+
+// halt: settotal(0) ends the move after the committed pulses, and the done callback still comes
+static void test_halt(void)
+{
+  startmove(5000, 0, 10000, moving_in, 1);
+  fake.pulse(1000);
+  uint32_t total = stepgen->settotal(0);
+  CHECK(total == fake.committed);
+  CHECK(total - stepgen->stepsdone() <= FAKE_MEM);
+  hwmv.total = total;
+  finish();
+  CHECK(donecalls == 1);
+  uint32_t done = stepgen->stepsdone();
+  CHECK(done == total);
+  CHECK(hwmv.position(done) == 5000 - total);
+
+  // settotal() after the end does not restart the move
+  CHECK(stepgen->settotal(20000) == total);
+  CHECK(!stepgen->busy());
+}
+
+// coarse moves, each pulse moves the focuser weight fine steps
+static void test_weight(void)
+{
+  startmove(1000, 2, 100, moving_out, 4);
+  fake.pulse(12);
+  CHECK(hwmv.position(stepgen->stepsdone()) == 1040);
+  CHECK(hwmv.retarget(stepgen->stepsdone(), 1042) == 0);
+  CHECK(retarget(1400));
+  finish();
+  CHECK(hwmv.position(stepgen->stepsdone()) == 1400);
+}
+
+int main(void)
+{
+  CHECK(stepgen->begin(4, stepgen_done));
+  test_move();
+  test_retarget();
+  test_halt();
+  test_weight();
+  CHECK(fake.starts == 9);
+  return hosttest_result("test_stepgen");
+}
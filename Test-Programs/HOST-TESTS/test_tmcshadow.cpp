@@ -0,0 +1,148 @@
+// ======================================================================
+// test_tmcshadow.cpp : host test of the TMC shadow registers, tmcshadow.cpp
+// ======================================================================
+// The driver is the TMC2209 stand in of stubs/TMCStepper.h, which counts the
+// UART writes and reads. Checks that unchanged values are skipped, that writes
+// are batched until flush(), and that poll() reads one status register per
+// TMCPOLLINTERVAL.
+
+#include "hosttest.h"
+#include "tmcshadow.h"
+
+static void test_skip(void)
+{
+  TMC2209Stepper drv = {};
+  TmcShadow shadow;
+  hosttest_millis() = 1000;
+  shadow.begin(&drv);
+
+  // nothing is known about the driver after begin(), so the first write is sent even for 0
+  shadow.set(TMCREG_SEMIN, 0);
+  shadow.flush();
+  CHECK(drv.regwrites[TMCREG_SEMIN] == 1);
+  CHECK(shadow.writes == 1);
+
+  // the same value again is not sent
+  shadow.set(TMCREG_SEMIN, 0);
+  shadow.flush();
+  CHECK(drv.regwrites[TMCREG_SEMIN] == 1);
+  CHECK(shadow.skipped == 1);
+
+  // changed and back before the flush, nothing to send
+  shadow.set(TMCREG_CURRENT, 600);
+  shadow.flush();
+  shadow.set(TMCREG_CURRENT, 800);
+  CHECK(shadow.get(TMCREG_CURRENT) == 800);
+  shadow.set(TMCREG_CURRENT, 600);
+  shadow.flush();
+  CHECK(drv.regwrites[TMCREG_CURRENT] == 1);
+  CHECK(drv.current == 600);
+  CHECK(shadow.skipped == 2);
+  CHECK(drv.uartwrites == shadow.writes);
+}
+
+static void test_batch(void)
+{
+  TMC2209Stepper drv = {};
+  TmcShadow shadow;
+  hosttest_millis() = 1000;
+  shadow.begin(&drv);
+
+  // nothing goes to the driver before flush(), the value read back is the pending one
+  shadow.set(TMCREG_MRES, 16);
+  shadow.set(TMCREG_MRES, 32);
+  shadow.set(TMCREG_MRES, 64);
+  shadow.set(TMCREG_TPWMTHRS, 500);
+  shadow.set(TMCREG_SGTHRS, 100);
+  shadow.set(TMCREG_TCOOLTHRS, 0xfffff);
+  CHECK(drv.uartwrites == 0);
+  CHECK(shadow.get(TMCREG_MRES) == 64);
+
+  // one write per register, with the last value
+  shadow.flush();
+  CHECK(drv.uartwrites == 4);
+  CHECK(drv.regwrites[TMCREG_MRES] == 1);
+  CHECK(drv.mres == 64);
+  CHECK(drv.tpwmthrs == 500);
+  CHECK(drv.sgthrs == 100);
+  CHECK(drv.tcoolthrs == 0xfffff);
+  CHECK(drv.regwrites[TMCREG_CURRENT] == 0);
+  CHECK(drv.regwrites[TMCREG_SEMIN] == 0);
+
+  // a flush with nothing pending sends nothing
+  shadow.flush();
+  CHECK(drv.uartwrites == 4);
+
+  // a move that sets the same step mode, thresholds and current as the last one costs no UART writes
+  for ( int move = 0; move < 10; move++ )
+  {
+    shadow.set(TMCREG_MRES, 64);
+    shadow.set(TMCREG_TPWMTHRS, 500);
+    shadow.set(TMCREG_TCOOLTHRS, 0xfffff);
+    shadow.flush();
+  }
+  CHECK(drv.uartwrites == 4);
+  CHECK(shadow.skipped == 30);
+  CHECK(shadow.writes == 4);
+}
+
+static void test_poll(void)
+{
+  TMC2209Stepper drv = {};
+  TmcShadow shadow;
+  hosttest_millis() = 1000;
+  shadow.begin(&drv);
+  drv.drvstatus = 0x80000010;
+  drv.sgresult  = 123;
+
+  // nothing is read before the interval is over
+  for ( unsigned long t = 0; t < TMCPOLLINTERVAL; t += 10 )
+  {
+    hosttest_millis() = 1000 + t;
+    shadow.poll();
+  }
+  CHECK(drv.uartreads == 0);
+  CHECK(shadow.drvstatus() == 0);
+
+  // one read per interval, DRV_STATUS and SG_RESULT in turn, the readers get the last values
+  hosttest_millis() = 1000 + TMCPOLLINTERVAL;
+  shadow.poll();
+  shadow.poll();
+  CHECK(drv.uartreads == 1);
+  CHECK(drv.statusreads == 1);
+  CHECK(shadow.drvstatus() == 0x80000010);
+  CHECK(shadow.sgresult() == 0);
+
+  hosttest_millis() += TMCPOLLINTERVAL;
+  shadow.poll();
+  CHECK(drv.sgreads == 1);
+  CHECK(shadow.sgresult() == 123);
+
+  for ( int i = 0; i < 100; i++ )
+  {
+    hosttest_millis() += TMCPOLLINTERVAL / 4;
+    shadow.poll();
+  }
+  CHECK(drv.uartreads == 2 + 25);
+  CHECK(shadow.reads == drv.uartreads);
+  CHECK((drv.statusreads >= 13) && (drv.sgreads >= 13));
+
+  // polling keeps going over the wrap of millis()
+  hosttest_millis() = ~0UL - TMCPOLLINTERVAL / 2;
+  shadow.poll();
+  uint32_t reads = drv.uartreads;
+  hosttest_millis() += TMCPOLLINTERVAL;         // wraps
+  shadow.poll();
+  CHECK(drv.uartreads == reads + 1);
+
+  // reads never cause writes
+  CHECK(drv.uartwrites == 0);
+}
+
+int main(void)
+{
+  test_skip();
+  test_batch();
+  test_poll();
+  return hosttest_result("test_tmcshadow");
+}
@@ -0,0 +1,157 @@
+// ======================================================================
+// test_velocity.cpp : host test of the velocity step intervals, velocity.h
+// ======================================================================
+// Table driven over every board file in data/boards: msdelay, stepmode and
+// brdnum come from the .jsn, then the board minimum interval, the clamp of the
+// motorvelocity setting and both velocity units are checked for the board.
+
+#include "hosttest.h"
+#include "velocity.h"
+#include <dirent.h>
+#include <string>
+
+#ifndef BOARDDIR
+#define BOARDDIR "../../src/myFP2ESP/data/boards"
+#endif
+
+struct BoardFile
+{
+  std::string name;
+  long brdnum;
+  long stepmode;
+  long msdelay;
+};
+
+// value of a numeric key in a one line board file, false if it is missing
+static bool jsn_long(const std::string &jsn, const char *key, long &value)
+{
+  std::string k = std::string("\"") + key + "\":";
+  size_t at = jsn.find(k);
+  if ( at == std::string::npos )
+  {
+    return false;
+  }
+  value = strtol(jsn.c_str() + at + k.size(), NULL, 10);
+  return true;
+}
+
+static bool readboard(const std::string &path, BoardFile &b)
+{
+  FILE *f = fopen(path.c_str(), "r");
+  if ( f == NULL )
+  {
+    return false;
+  }
+  std::string jsn;
+  char buf[256];
+  size_t n;
+  while ( (n = fread(buf, 1, sizeof(buf), f)) > 0 )
+  {
+    jsn.append(buf, n);
+  }
+  fclose(f);
+  return jsn_long(jsn, "brdnum", b.brdnum) && jsn_long(jsn, "stepmode", b.stepmode) && jsn_long(jsn, "msdelay", b.msdelay);
+}
+
+static bool istmc(long brdnum)
+{
+  return (brdnum == PRO2ESP32TMC2225) || (brdnum == PRO2ESP32TMC2209) || (brdnum == PRO2ESP32TMC2209P);
+}
+
+static unsigned long atleast(unsigned long us)
+{
+  return ( us < VELOCITYMININTERVAL ) ? VELOCITYMININTERVAL : us;
+}
+
+static void test_board(const BoardFile &b)
+{
+  int failures = hosttest_failures;
+  bool tmc = istmc(b.brdnum);
+  unsigned long minspd = board_mininterval(b.msdelay, tmc, b.stepmode);
+
+  // the board minimum, msdelay is per full step on TMC boards
+  CHECK(minspd >= VELOCITYMININTERVAL);
+  CHECK(minspd == atleast(tmc ? b.msdelay / b.stepmode : b.msdelay));
+  if ( tmc )
+  {
+    CHECK(board_mininterval(b.msdelay, tmc, 3) == atleast(b.msdelay / STEP4));    // not a power of 2
+    CHECK(board_mininterval(b.msdelay, tmc, 0) == atleast(b.msdelay / STEP4));
+    CHECK(board_mininterval(b.msdelay, tmc, 512) == atleast(b.msdelay / STEP4));
+    CHECK(board_mininterval(b.msdelay, tmc, STEP256) == atleast(b.msdelay / STEP256));
+  }
+  else
+  {
+    CHECK(board_mininterval(b.msdelay, tmc, STEP32) == minspd);                   // microsteps do not change it
+  }
+
+  // no velocity set, the board msdelay is used, in both units
+  CHECK(fast_interval(0, VELOCITY_FULLSTEPS, b.stepmode, 2.5, minspd) == minspd);
+  CHECK(fast_interval(0, VELOCITY_MICRONS, b.stepmode, 2.5, minspd) == minspd);
+
+  // full steps/s: interval of velocity * microsteps, never faster than the board
+  for ( unsigned long v = 1; v <= MAXMOTORVELOCITY; v *= 7 )
+  {
+    unsigned long us = 1000000UL / (v * b.stepmode);
+    unsigned long got = fast_interval(v, VELOCITY_FULLSTEPS, b.stepmode, 2.5, minspd);
+    CHECK((got == ((us < minspd) ? minspd : us)) || (got + 1 == us));       // float rounding may drop 1 uS
+  }
+  CHECK(fast_interval(MAXMOTORVELOCITY, VELOCITY_FULLSTEPS, b.stepmode, 2.5, minspd) == minspd);
+
+  // um/s: interval of velocity / stepsize, a stepsize of 0 is no valid velocity
+  CHECK(velocity_interval(100, VELOCITY_MICRONS, b.stepmode, 2.5) == 25000);    // 40 steps/s
+  CHECK(fast_interval(100, VELOCITY_MICRONS, b.stepmode, 2.5, minspd) == ((minspd > 25000) ? minspd : 25000));
+  CHECK(fast_interval(100, VELOCITY_MICRONS, b.stepmode, 0.0, minspd) == minspd);
+  CHECK(fast_interval(MAXMOTORVELOCITY, VELOCITY_MICRONS, b.stepmode, 0.1, minspd) == minspd);
+
+  // faster never gives a longer interval
+  unsigned long last = fast_interval(1, VELOCITY_FULLSTEPS, b.stepmode, 2.5, minspd);
+  bool monotonic = true;
+  for ( unsigned long v = 2; v <= 20000; v += 13 )
+  {
+    unsigned long us = fast_interval(v, VELOCITY_FULLSTEPS, b.stepmode, 2.5, minspd);
+    monotonic = monotonic && (us <= last) && (us >= minspd);
+    last = us;
+  }
+  CHECK(monotonic);
+
+  if ( hosttest_failures != failures )
+  {
+    printf("  board %s: brdnum %ld, stepmode %ld, msdelay %ld\n", b.name.c_str(), b.brdnum, b.stepmode, b.msdelay);
+  }
+}
+
+int main(void)
+{
+  DIR *dir = opendir(BOARDDIR);
+  CHECK(dir != NULL);
+  int boards = 0;
+  bool tmcfound = false;
+  struct dirent *de;
+  while ( (dir != NULL) && ((de = readdir(dir)) != NULL) )
+  {
+    std::string name = de->d_name;
+    if ( (name.size() < 4) || (name.compare(name.size() - 4, 4, ".jsn") != 0) )
+    {
+      continue;
+    }
+    BoardFile b;
+    b.name = name;
+    bool ok = readboard(std::string(BOARDDIR) + "/" + name, b);
+    CHECK(ok);
+    CHECK(ok && (b.msdelay > 0) && (b.stepmode >= STEP1));
+    if ( ok && (b.msdelay > 0) && (b.stepmode >= STEP1) )
+    {
+      test_board(b);
+      boards++;
+      tmcfound = tmcfound || istmc(b.brdnum);
+    }
+  }
+  if ( dir != NULL )
+  {
+    closedir(dir);
+  }
+  CHECK(boards >= 20);
+  CHECK(tmcfound);
+  printf("test_velocity: %d boards\n", boards);
+  return hosttest_result("test_velocity");
+}
@@ -61,11 +61,11 @@ extern SetupData      *mySetupData;
 extern DriverBoard    *driverboard;
 extern unsigned long  ftargetPosition;              // target position
 extern char           ipStr[];
-extern byte           isMoving;                     // is the motor currently moving
 extern bool           ascomserverstate;
 extern bool           ascomdiscoverystate;
 extern float          lasttemp;
 extern void           heapmsg(void);
+extern void           motion_command(byte, long);
 
 // ======================================================================
 // LOCAL DATA: ASCOM ALPACA REMOTE SERVER
@@ -174,7 +174,9 @@ void ASCOM_Create_Setup_Focuser_HomePage()
   // Convert IP address to a string;
   // already in ipStr
   // convert current values of focuserposition and focusermaxsteps to string types
-  String fpbuffer = String(driverboard->getposition());
+  MotionState ms;
+  driverboard->getmotionstate(ms);
+  String fpbuffer = String(ms.position);
   String mxbuffer = String(mySetupData->get_maxstep());
   String smbuffer = String(mySetupData->get_brdstepmode());
   int    eflag    = 0;
@@ -558,9 +560,7 @@ void ASCOM_handle_focuser_setup()
       temp = fp.toInt();
       temp = ( temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
-      ftargetPosition = (unsigned long) temp;
-      driverboard->setposition(ftargetPosition);
-      mySetupData->set_fposition(ftargetPosition);
+      motion_command(MOTION_SETPOSITION, temp);
     }
   }
 
@@ -572,9 +572,11 @@ void ASCOM_handle_focuser_setup()
     Ascom_DebugPrint("root() -maxsteps:");
     Ascom_DebugPrintln(fmax_str);
     temp = fmax_str.toInt();
-    if ( temp < (long) driverboard->getposition() )     // if maxstep is less than focuser position
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    if ( temp < (long) ms.position )                    // if maxstep is less than focuser position
     {
-      temp = (long) driverboard->getposition() + 1;
+      temp = (long) ms.position + 1;
     }
     if ( temp < FOCUSERLOWERLIMIT )                     // do not set it less then 1024
     {
@@ -640,7 +642,7 @@ void ASCOM_handle_focuser_setup()
 
   // ======================================================================
   // Basic rule for setting stepmode
-  // Set driverboard->setstepmode(xx);                 // this sets the physical pins and saves new step mode
+  // Send motion_command(MOTION_STEPMODE, xx);          // the motion task sets the physical pins and saves new step mode
   // ======================================================================
   // if update stepmode
   // (1=Full, 2=Half, 4=1/4, 8=1/8, 16=1/16, 32=1/32, 64=1/64, 128=1/128, 256=1/256)
@@ -660,8 +662,8 @@ void ASCOM_handle_focuser_setup()
     {
       temp = mySetupData->get_brdmaxstepmode();
     }
-    // call boards.cpp to apply physical pins and save new stepmode
-    driverboard->setstepmode(temp);
+    // the motion task applies the physical pins and saves new stepmode
+    motion_command(MOTION_STEPMODE, temp);
   }
 
   Ascom_DebugPrintln("build homepage");
@@ -954,8 +956,10 @@ void  ASCOM_handlepositionget()
   ASCOMErrorNumber = 0;
   ASCOMErrorMessage = ASCOMERRORMSGNULL;
   ASCOM_getURLParameters();
+  MotionState ms;
+  driverboard->getmotionstate(ms);
   // addclientinfo adds clientid, clienttransactionid, servtransactionid, errornumber, errormessage and terminating }
-  jsonretstr = "{\"Value\":" + String(driverboard->getposition()) + "," + ASCOM_addclientinfo( jsonretstr );
+  jsonretstr = "{\"Value\":" + String(ms.position) + "," + ASCOM_addclientinfo( jsonretstr );
   // sendreply builds http header, sets content type, and then sends jsonretstr
   ASCOM_sendreply( NORMALWEBPAGE, JSONPAGETYPE, jsonretstr);
 }
@@ -970,9 +974,7 @@ void  ASCOM_handlehaltput()
   ASCOMErrorNumber = 0;
   ASCOMErrorMessage = ASCOMERRORMSGNULL;
   ASCOM_getURLParameters();
-  varENTER_CRITICAL(&halt_alertMux);
-  halt_alert = true;
-  varEXIT_CRITICAL(&halt_alertMux);
+  motion_command(MOTION_HALT, 0);
 
   //ftargetPosition = fcurrentPosition;
   // addclientinfo adds clientid, clienttransactionid, servtransactionid, errornumber, errormessage and terminating }
@@ -991,8 +993,10 @@ void ASCOM_handleismovingget()
   ASCOMErrorNumber = 0;
   ASCOMErrorMessage = ASCOMERRORMSGNULL;
   ASCOM_getURLParameters();
+  MotionState ms;
+  driverboard->getmotionstate(ms);
   // addclientinfo adds clientid, clienttransactionid, servtransactionid, errornumber, errormessage and terminating }
-  if ( isMoving == 1 )
+  if ( ms.moving == 1 )
   {
     jsonretstr = "{\"Value\":1,"  + ASCOM_addclientinfo( jsonretstr );
   }
@@ -1125,7 +1129,7 @@ void ASCOM_handlemoveput()
     newpos = 0;
     Ascom_DebugPrint("new position: ");
     Ascom_DebugPrintln(newpos);
-    ftargetPosition = newpos;
+    motion_command(MOTION_MOVE, newpos);
     jsonretstr = "{" + ASCOM_addclientinfo( jsonretstr );
     ASCOM_sendreply( NORMALWEBPAGE, JSONPAGETYPE, jsonretstr);
   }
@@ -1135,7 +1139,7 @@ void ASCOM_handlemoveput()
     if (newpos > mySetupData->get_maxstep() )
     {
       newpos = mySetupData->get_maxstep();
-      ftargetPosition = newpos;
+      motion_command(MOTION_MOVE, newpos);
       Ascom_DebugPrint("new position: ");
       Ascom_DebugPrintln(newpos);
       jsonretstr = "{" + ASCOM_addclientinfo( jsonretstr );
@@ -1143,7 +1147,7 @@ void ASCOM_handlemoveput()
     }
     else
     {
-      ftargetPosition = newpos;
+      motion_command(MOTION_MOVE, newpos);
       Ascom_DebugPrint("new position: ");
       Ascom_DebugPrintln(newpos);
       jsonretstr = "{" + ASCOM_addclientinfo( jsonretstr );
@@ -1,104 +1,131 @@
 // ======================================================================
 // Queue.h: myFP2ESP Queue Routines
 // (c) Copyright Steven de Salas. All Rights Reserved.
-// Defines a templated (generic) class for a queue of things.
+// Defines a queue of received command lines.
 // ======================================================================
 // Modified by Robert Brown for use with ESP32, August 2019
+// Single producer/single consumer ring of fixed command slots, the reader fills the
+// slot in place so no String is built per character. The producer may be a UART RX
+// interrupt or a reader task, the consumer is the comms loop.
 
 #ifndef ESPQueue_H
 #define ESPQueue_H
 
+#include "generalDefinitions.h"                     // QUEUELENGTH, CMDBUFSIZE
+
+#define QUEUESLOTS        (QUEUELENGTH + 1)         // one slot is always being filled by the producer
+
 class Queue {
   private:
-    int _front, _back, _count;
-    String *_data;
-    int _maxitems;
+    char     _slot[QUEUESLOTS][CMDBUFSIZE];
+    uint16_t _len;                                  // producer, chars in the slot being filled
+    volatile uint8_t  _head;                        // producer, slot being filled
+    volatile uint8_t  _tail;                        // consumer, oldest complete command
+    volatile uint32_t _overflows;                   // commands dropped, queue full
+    volatile uint32_t _toolong;                     // commands longer than a slot, dropped
   public:
-    Queue(int maxitems = 256) 
-    { 
-      _front = 0;
-      _back = 0;
-      _count = 0;
-      _maxitems = maxitems;
-      _data = new String[maxitems + 1];   
-    }
-    ~Queue() 
+    Queue(void)
     {
-      delete[] _data;  
+      _len = 0;
+      _head = 0;
+      _tail = 0;
+      _overflows = 0;
+      _toolong = 0;
     }
-    inline int count();
-    inline int front();
-    inline int back();
-    void push(const String &item);
-    String peek();
-    String pop();
-    void clear();
+    // producer
+    inline void start(void);
+    inline void put(char);
+    inline bool push(void);
+    // consumer
+    inline int count(void);
+    inline size_t pop(char *, size_t);
+    inline void clear(void);
+    inline uint32_t overflows(void);
+    inline uint32_t toolong(void);
 };
 
-inline int Queue::count() 
+// producer, start a new command in the slot being filled
+inline void IRAM_ATTR Queue::start(void)
 {
-  return _count;
+  _len = 0;
 }
 
-inline int Queue::front() 
+// producer, add a character to the command, a command that does not fit the slot is marked too long
+inline void IRAM_ATTR Queue::put(char c)
 {
-  return _front;
+  if ( _len < CMDBUFSIZE - 1 )
+  {
+    _slot[_head][_len++] = c;
+  }
+  else
+  {
+    _len = CMDBUFSIZE;
+  }
 }
 
-inline int Queue::back() 
+// producer, the command is complete. returns false if it is dropped, too long (as the TCP reader
+// does, a cut command could be a different valid one) or the queue is full
+inline bool IRAM_ATTR Queue::push(void)
 {
-  return _back;
+  uint8_t next = (_head + 1) % QUEUESLOTS;
+  uint16_t len = _len;
+  _len = 0;
+  if ( len == CMDBUFSIZE )
+  {
+    _toolong = _toolong + 1;
+    return false;
+  }
+  if ( next == _tail )
+  {
+    _overflows = _overflows + 1;                    // slot is reused for the next command
+    return false;
+  }
+  _slot[_head][len] = '\0';
+  __sync_synchronize();                             // slot contents visible before the consumer sees it
+  _head = next;
+  return true;
 }
 
-void Queue::push(const String &item)
+// consumer, complete commands waiting
+inline int Queue::count(void)
 {
-  if(_count < _maxitems) 
-  { 
-    // Drops out when full
-    _data[_back++]=item;
-    ++_count;
-    // Check wrap around
-    if (_back > _maxitems)
-    {
-      _back -= (_maxitems + 1);
-    }
-  }
+  return (_head + QUEUESLOTS - _tail) % QUEUESLOTS;
 }
 
-String Queue::pop() {
-  if(_count <= 0) 
+// consumer, copy the oldest command to buf and release its slot, returns its length, 0 if empty
+inline size_t Queue::pop(char *buf, size_t size)
+{
+  if ( (_tail == _head) || (size == 0) )
   {
-    return String(); // Returns empty
+    return 0;
   }
-  else 
+  __sync_synchronize();                             // read the slot after the producer published it
+  size_t n = 0;
+  while ( (n < size - 1) && (_slot[_tail][n] != '\0') )
   {
-    String result = _data[_front];
-    _front++;
-    --_count;
-    // Check wrap around
-    if (_front > _maxitems) 
-    {
-      _front -= (_maxitems + 1);
-    }
-    return result; 
+    buf[n] = _slot[_tail][n];
+    n++;
   }
+  buf[n] = '\0';
+  __sync_synchronize();
+  _tail = (_tail + 1) % QUEUESLOTS;
+  return n;
 }
 
-String Queue::peek() {
-  if(_count <= 0)
-  {
-    return String(); // Returns empty
-  }
-  else
-  {
-    return _data[_front];
-  }
+// consumer, drop all waiting commands
+inline void Queue::clear(void)
+{
+  _tail = _head;
+}
+
+inline uint32_t Queue::overflows(void)
+{
+  return _overflows;
 }
 
-void Queue::clear() 
+inline uint32_t Queue::toolong(void)
 {
-  _front = _back;
-  _count = 0;
+  return _toolong;
 }
 
 #endif
@@ -36,6 +36,9 @@ extern byte isMoving;
 SetupData::SetupData(void)
 {
   SetupData_DebugPrintln("Setupdata: Constructor");
+#if defined(SETUPDATALOCK)
+  this->mutex = xSemaphoreCreateRecursiveMutex();
+#endif
 
   this->SnapShotMillis      = millis();
   this->BoardSnapShotMillis = millis();
@@ -59,6 +62,20 @@ SetupData::SetupData(void)
   this->LoadConfiguration();
 };
 
+void SetupData::lock(void)
+{
+#if defined(SETUPDATALOCK)
+  xSemaphoreTakeRecursive(this->mutex, portMAX_DELAY);
+#endif
+}
+
+void SetupData::unlock(void)
+{
+#if defined(SETUPDATALOCK)
+  xSemaphoreGiveRecursive(this->mutex);
+#endif
+}
+
 // Loads the configuration from a file
 byte SetupData::LoadConfiguration()
 {
@@ -134,11 +151,25 @@ byte SetupData::LoadConfiguration()
       this->forcedownload         = doc_per["fcdownld"];
       this->oledpageoption        = doc_per["oledpg"];
       this->motorspeed            = doc_per["mspeed"];                  // motorspeed slow, med, fast
+      this->motorprofile          = doc_per["mprofile"];                // trapezoid, s-curve
       this->hpswitchenable        = doc_per["hpswen"];
       this->pbenable              = doc_per["pbenable"];
       this->stallguard            = doc_per["stallguard"];
       this->tmc2225current        = doc_per["tmc2225mA"];
       this->tmc2209current        = doc_per["tmc2209mA"];
+      this->motoraccel            = doc_per["maccel"];                  // 0 if missing, no ramp
+      this->motormaxspeed         = doc_per["mmaxspeed"];
+      this->motorvelocity         = doc_per["mvelocity"];               // 0 if missing, use board msdelay
+      this->velocityunit          = doc_per["mvelunit"];
+      this->homesteps             = doc_per["homesteps"] | HOMESTEPS;   // limit of homing moves
+      this->motorspeedthreshold   = doc_per["msthres"] | MSTHRESHOLD;
+      this->motorspeedchange      = doc_per["mschange"];
+      this->coarsestepmode        = doc_per["coarsesm"];                // 0 if missing, no coarse slew
+      this->finesteps             = doc_per["finesteps"] | FINESTEPS;
+      this->spreadvelocity        = doc_per["spreadvel"];               // 0 if missing, always StealthChop
+      this->coolstep              = doc_per["coolstep"];
+      this->approachdir           = doc_per["apdir"];                   // 0 if missing, backlash steps
+      this->overshoot             = doc_per["overshoot"] | DEFAULTOVERSHOOT;
     }
     SetupData_DebugPrintln("data_per loaded");
   }
@@ -260,6 +291,7 @@ byte SetupData::LoadConfiguration()
 // called froms comms.h case 42: reset focuser to defaults
 void SetupData::SetFocuserDefaults(void)
 {
+  this->lock();
   LoadDefaultPersistantData();
   LoadDefaultBoardData();
   LoadDefaultVariableData();
@@ -278,10 +310,20 @@ void SetupData::SetFocuserDefaults(void)
   {
     SPIFFS.remove(filename_variable);
   }
+  this->unlock();
 }
 
 // Saves the configurations to files
 boolean SetupData::SaveConfiguration(unsigned long currentPosition, byte DirOfTravel)
+{
+  this->lock();
+  boolean cstatus = this->SaveChanged(currentPosition, DirOfTravel);
+  this->unlock();
+  return cstatus;
+}
+
+// SaveConfiguration() with the lock held
+boolean SetupData::SaveChanged(unsigned long currentPosition, byte DirOfTravel)
 {
   if (this->fposition != currentPosition || this->focuserdirection != DirOfTravel)  // last focuser position
   {
@@ -359,12 +401,18 @@ boolean SetupData::SaveConfiguration(unsigned long currentPosition, byte DirOfTr
 
 boolean SetupData::SaveNow()                          // used by reboot to save settings
 {
-  return SavePersitantConfiguration();
+  this->lock();
+  boolean saved = SavePersitantConfiguration();
+  this->unlock();
+  return saved;
 }
 
 boolean SetupData::SaveBoardConfigNow(void)
 {
-  return WriteBoardConfiguration();
+  this->lock();
+  boolean saved = WriteBoardConfiguration();
+  this->unlock();
+  return saved;
 }
 
 // ======================================================================
@@ -444,6 +492,7 @@ void SetupData::LoadDefaultPersistantData()
   this->oledupdateonmove      = DEFAULTON;
   this->oledpagetime          = OLEDPAGETIMEMIN;       // 2, 3 -- 10
   this->motorspeed            = FAST;
+  this->motorprofile          = PROFILE_TRAPEZOID;
   this->displayenabled        = DEFAULTON;
   for (int i = 0; i < 10; i++)
   {
@@ -471,6 +520,19 @@ void SetupData::LoadDefaultPersistantData()
   this->stallguard            = STALL_VALUE;
   this->tmc2225current        = TMC2225CURRENT;
   this->tmc2209current        = TMC2209CURRENT;
+  this->motoraccel            = DEFAULTMOTORACCEL;    // no ramp
+  this->motormaxspeed         = DEFAULTMOTORMAXSPEED; // use board msdelay
+  this->motorvelocity         = DEFAULTMOTORVELOCITY; // use board msdelay
+  this->velocityunit          = VELOCITY_FULLSTEPS;
+  this->homesteps             = HOMESTEPS;
+  this->motorspeedthreshold   = MSTHRESHOLD;
+  this->motorspeedchange      = DEFAULTOFF;
+  this->coarsestepmode        = DEFAULTCOARSESTEPMODE;
+  this->finesteps             = FINESTEPS;
+  this->spreadvelocity        = DEFAULTSPREADVELOCITY;
+  this->coolstep              = DEFAULTOFF;
+  this->approachdir           = APPROACH_OFF;
+  this->overshoot             = DEFAULTOVERSHOOT;
   this->SavePersitantConfiguration();                 // write default values to SPIFFS
 }
 
@@ -549,11 +611,25 @@ byte SetupData::SavePersitantConfiguration()
   doc["fcdownld"]           = this->forcedownload;
   doc["oledpg"]             = this->oledpageoption;
   doc["mspeed"]             = this->motorspeed;
+  doc["mprofile"]           = this->motorprofile;
   doc["hpswen"]             = this->hpswitchenable;
   doc["pbenable"]           = this->pbenable;
   doc["stallguard"]         = this->stallguard;
   doc["tmc2225mA"]          = this->tmc2225current;
   doc["tmc2209mA"]          = this->tmc2209current;
+  doc["maccel"]             = this->motoraccel;
+  doc["mmaxspeed"]          = this->motormaxspeed;
+  doc["mvelocity"]          = this->motorvelocity;
+  doc["mvelunit"]           = this->velocityunit;
+  doc["homesteps"]          = this->homesteps;
+  doc["msthres"]            = this->motorspeedthreshold;
+  doc["mschange"]           = this->motorspeedchange;
+  doc["coarsesm"]           = this->coarsestepmode;
+  doc["finesteps"]          = this->finesteps;
+  doc["spreadvel"]          = this->spreadvelocity;
+  doc["coolstep"]           = this->coolstep;
+  doc["apdir"]              = this->approachdir;
+  doc["overshoot"]          = this->overshoot;
 
   // Serialize JSON to file
   SetupData_DebugPrintln("Writing to file");
@@ -600,12 +676,12 @@ byte SetupData::get_DelayAfterMove()
   return this->DelayAfterMove;        // delay after movement is finished (maxval=256)
 }
 
-byte SetupData::get_backlashsteps_in()
+uint16_t SetupData::get_backlashsteps_in()
 {
   return this->backlashsteps_in;      // number of backlash steps to apply for IN moves
 }
 
-byte SetupData::get_backlashsteps_out()
+uint16_t SetupData::get_backlashsteps_out()
 {
   return this->backlashsteps_out;     // number of backlash steps to apply for OUT moves
 }
@@ -680,6 +756,11 @@ byte SetupData::get_motorspeed()
   return this->motorspeed;            // the stepper motor speed, slow, medium, fast
 }
 
+byte SetupData::get_motorprofile()
+{
+  return this->motorprofile;          // the acceleration profile, trapezoid, s-curve
+}
+
 byte SetupData::get_displayenabled()
 {
   return this->displayenabled;        // the state of the oled display, enabled or !enabled
@@ -801,6 +882,71 @@ int SetupData::get_tmc2209current()
   return this->tmc2209current;
 }
 
+unsigned long SetupData::get_motoraccel()
+{
+  return this->motoraccel;
+}
+
+unsigned long SetupData::get_motormaxspeed()
+{
+  return this->motormaxspeed;
+}
+
+unsigned long SetupData::get_motorvelocity()
+{
+  return this->motorvelocity;
+}
+
+byte SetupData::get_velocityunit()
+{
+  return this->velocityunit;
+}
+
+unsigned long SetupData::get_homesteps()
+{
+  return this->homesteps;
+}
+
+unsigned long SetupData::get_motorspeedthreshold()
+{
+  return this->motorspeedthreshold;
+}
+
+byte SetupData::get_motorspeedchange()
+{
+  return this->motorspeedchange;
+}
+
+int SetupData::get_coarsestepmode()
+{
+  return this->coarsestepmode;
+}
+
+unsigned long SetupData::get_finesteps()
+{
+  return this->finesteps;
+}
+
+unsigned long SetupData::get_spreadvelocity()
+{
+  return this->spreadvelocity;
+}
+
+byte SetupData::get_coolstep()
+{
+  return this->coolstep;
+}
+
+byte SetupData::get_approachdir()
+{
+  return this->approachdir;
+}
+
+unsigned long SetupData::get_overshoot()
+{
+  return this->overshoot;
+}
+
 //__Setter
 
 void SetupData::set_fposition(unsigned long fposition)
@@ -828,12 +974,12 @@ void SetupData::set_DelayAfterMove(byte DelayAfterMove)
   this->StartDelayedUpdate(this->DelayAfterMove, DelayAfterMove); // delay after movement is finished (maxval=256)
 }
 
-void SetupData::set_backlashsteps_in(byte backlashsteps)
+void SetupData::set_backlashsteps_in(uint16_t backlashsteps)
 {
   this->StartDelayedUpdate(this->backlashsteps_in, backlashsteps); // number of backlash steps to apply for IN moves
 }
 
-void SetupData::set_backlashsteps_out(byte backlashsteps_out)
+void SetupData::set_backlashsteps_out(uint16_t backlashsteps_out)
 {
   this->StartDelayedUpdate(this->backlashsteps_out, backlashsteps_out); // number of backlash steps to apply for OUT moves
 }
@@ -908,6 +1054,11 @@ void SetupData::set_motorspeed(byte motorspeed)
   this->StartDelayedUpdate(this->motorspeed, motorspeed);
 }
 
+void SetupData::set_motorprofile(byte motorprofile)
+{
+  this->StartDelayedUpdate(this->motorprofile, motorprofile);
+}
+
 void SetupData::set_displayenabled(byte displaystate)
 {
   this->StartDelayedUpdate(this->displayenabled, displaystate);
@@ -1028,8 +1179,74 @@ void SetupData::set_tmc2209current(int newval)
   this->StartDelayedUpdate(this->tmc2209current, newval);
 }
 
+void SetupData::set_motoraccel(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->motoraccel, newval);
+}
+
+void SetupData::set_motormaxspeed(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->motormaxspeed, newval);
+}
+
+void SetupData::set_motorvelocity(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->motorvelocity, newval);
+}
+
+void SetupData::set_velocityunit(byte newval)
+{
+  this->StartDelayedUpdate(this->velocityunit, newval);
+}
+
+void SetupData::set_homesteps(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->homesteps, newval);
+}
+
+void SetupData::set_motorspeedthreshold(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->motorspeedthreshold, newval);
+}
+
+void SetupData::set_motorspeedchange(byte newval)
+{
+  this->StartDelayedUpdate(this->motorspeedchange, newval);
+}
+
+void SetupData::set_coarsestepmode(int newval)
+{
+  this->StartDelayedUpdate(this->coarsestepmode, newval);
+}
+
+void SetupData::set_finesteps(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->finesteps, newval);
+}
+
+void SetupData::set_spreadvelocity(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->spreadvelocity, newval);
+}
+
+void SetupData::set_coolstep(byte newval)
+{
+  this->StartDelayedUpdate(this->coolstep, newval);
+}
+
+void SetupData::set_approachdir(byte newval)
+{
+  this->StartDelayedUpdate(this->approachdir, newval);
+}
+
+void SetupData::set_overshoot(unsigned long newval)
+{
+  this->StartDelayedUpdate(this->overshoot, newval);
+}
+
 void SetupData::StartDelayedUpdate(int & org_data, int new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveData_per = true;
@@ -1037,10 +1254,12 @@ void SetupData::StartDelayedUpdate(int & org_data, int new_data)
     org_data = new_data;
     DebugPrintln("++ request for saving persitant data");
   }
+  this->unlock();
 }
 
 void SetupData::StartDelayedUpdate(unsigned long & org_data, unsigned long new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveData_per = true;
@@ -1048,10 +1267,12 @@ void SetupData::StartDelayedUpdate(unsigned long & org_data, unsigned long new_d
     org_data = new_data;
     SetupData_DebugPrintln("++ request for saving persitant data");
   }
+  this->unlock();
 }
 
 void SetupData::StartDelayedUpdate(float & org_data, float new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveData_per = true;
@@ -1059,10 +1280,12 @@ void SetupData::StartDelayedUpdate(float & org_data, float new_data)
     org_data = new_data;
     SetupData_DebugPrintln("++ request for saving persitant data");
   }
+  this->unlock();
 }
 
 void SetupData::StartDelayedUpdate(byte & org_data, byte new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveData_per = true;
@@ -1070,10 +1293,25 @@ void SetupData::StartDelayedUpdate(byte & org_data, byte new_data)
     org_data = new_data;
     SetupData_DebugPrintln("++ request for saving persitant data");
   }
+  this->unlock();
+}
+
+void SetupData::StartDelayedUpdate(uint16_t & org_data, uint16_t new_data)
+{
+  this->lock();
+  if (org_data != new_data)
+  {
+    this->ReqSaveData_per = true;
+    this->SnapShotMillis = millis();
+    org_data = new_data;
+    SetupData_DebugPrintln("++ request for saving persitant data");
+  }
+  this->unlock();
 }
 
 void SetupData::StartDelayedUpdate(String & org_data, String new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveData_per = true;
@@ -1081,6 +1319,7 @@ void SetupData::StartDelayedUpdate(String & org_data, String new_data)
     org_data = new_data;
     SetupData_DebugPrintln("Save request for data_per.jsn");
   }
+  this->unlock();
 }
 
 // ======================================================================
@@ -1300,6 +1539,15 @@ boolean SetupData::SaveBoardConfiguration()
 }
 
 boolean SetupData::CreateBoardConfigfromjson(String jsonstr)
+{
+  this->lock();
+  boolean created = this->CreateBoardConfig(jsonstr);
+  this->unlock();
+  return created;
+}
+
+// CreateBoardConfigfromjson() with the lock held
+boolean SetupData::CreateBoardConfig(String jsonstr)
 {
   // generate board configuration from json string
   delay(10);
@@ -1392,7 +1640,7 @@ boolean SetupData::CreateBoardConfigfromjson(String jsonstr)
 }
 
 // getters
-String SetupData::get_brdname()
+const String &SetupData::get_brdname()
 {
   return this->board;
 }
@@ -1615,6 +1863,7 @@ void SetupData::set_brdmsdelay(unsigned long newval)
 
 void SetupData::StartBoardDelayedUpdate(int & org_data, int new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveBoard_var = true;
@@ -1622,10 +1871,12 @@ void SetupData::StartBoardDelayedUpdate(int & org_data, int new_data)
     org_data = new_data;
     SetupData_DebugPrintln("++ request for saving board data");
   }
+  this->unlock();
 }
 
 void SetupData::StartBoardDelayedUpdate(unsigned long & org_data, unsigned long new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveBoard_var = true;
@@ -1633,10 +1884,12 @@ void SetupData::StartBoardDelayedUpdate(unsigned long & org_data, unsigned long
     org_data = new_data;
     SetupData_DebugPrintln("++ request for saving board data");
   }
+  this->unlock();
 }
 
 void SetupData::StartBoardDelayedUpdate(byte & org_data, byte new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveBoard_var = true;
@@ -1644,10 +1897,12 @@ void SetupData::StartBoardDelayedUpdate(byte & org_data, byte new_data)
     org_data = new_data;
     SetupData_DebugPrintln("++ request for saving board data");
   }
+  this->unlock();
 }
 
 void SetupData::StartBoardDelayedUpdate(String & org_data, String new_data)
 {
+  this->lock();
   if (org_data != new_data)
   {
     this->ReqSaveBoard_var = true;
@@ -1655,6 +1910,7 @@ void SetupData::StartBoardDelayedUpdate(String & org_data, String new_data)
     org_data = new_data;
     SetupData_DebugPrintln("++ request for saving board data");
   }
+  this->unlock();
 }
 
 // ======================================================================
@@ -24,13 +24,25 @@
 #define DEFAULTVARDOCSIZE       64
 #define DEFAULTBOARDSIZE        1024      // board configuration - about 300 - https://arduinojson.org/v6/assistant/ deserialize
 
+#if defined(MOTIONTASK) && !defined(ESP8266)
+#define SETUPDATALOCK                     // the settings are shared by the motion and comms tasks
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#endif
+
 // ======================================================================
 // SetupData Class
 // ======================================================================
+// With the motion task, the comms task writes the settings and the motion task reads them and saves them to
+// SPIFFS. Setters, saves and resets hold the lock, so a String is never read while it is assigned. The motion
+// task holds it while it sets up a move, so one move sees one set of settings. Scalar reads are atomic.
+// Only the comms task assigns String settings, so it reads them without the lock.
 class SetupData
 {
   public:
     SetupData(void);
+    void lock(void);                                    // recursive, held for microseconds except by a save
+    void unlock(void);
     byte LoadConfiguration(void);
     boolean SaveConfiguration(unsigned long, byte);
     boolean SaveBoardConfiguration(void);               // delayed save board_config.jsn if changed
@@ -46,8 +58,8 @@ class SetupData
     unsigned long get_maxstep();
     float get_stepsize();
     byte get_DelayAfterMove();
-    byte get_backlashsteps_in();
-    byte get_backlashsteps_out();
+    uint16_t get_backlashsteps_in();
+    uint16_t get_backlashsteps_out();
     byte get_backlash_in_enabled();
     byte get_backlash_out_enabled();
     byte get_tempcoefficient();
@@ -62,6 +74,7 @@ class SetupData
     byte get_tempcompenabled();
     byte get_tcdirection();
     byte get_motorspeed();
+    byte get_motorprofile();
     byte get_displayenabled();
     unsigned long get_focuserpreset(byte);
     unsigned long get_webserverport();
@@ -86,6 +99,19 @@ class SetupData
     byte    get_stallguard();
     int     get_tmc2225current(void);
     int     get_tmc2209current(void);
+    unsigned long get_motoraccel(void);
+    unsigned long get_motormaxspeed(void);
+    unsigned long get_motorvelocity(void);
+    byte    get_velocityunit(void);
+    unsigned long get_homesteps(void);
+    unsigned long get_motorspeedthreshold(void);
+    byte    get_motorspeedchange(void);
+    int     get_coarsestepmode(void);
+    unsigned long get_finesteps(void);
+    unsigned long get_spreadvelocity(void);
+    byte    get_coolstep(void);
+    byte    get_approachdir(void);
+    unsigned long get_overshoot(void);
 
     //__setter data_per
     void set_fposition(unsigned long);
@@ -93,8 +119,8 @@ class SetupData
     void set_maxstep(unsigned long);
     void set_stepsize(float);
     void set_DelayAfterMove(byte);
-    void set_backlashsteps_in(byte);
-    void set_backlashsteps_out(byte);
+    void set_backlashsteps_in(uint16_t);
+    void set_backlashsteps_out(uint16_t);
     void set_backlash_in_enabled(byte);
     void set_backlash_out_enabled(byte);
     void set_tempcoefficient(byte);
@@ -109,6 +135,7 @@ class SetupData
     void set_tempcompenabled(byte);
     void set_tcdirection(byte);
     void set_motorspeed(byte);
+    void set_motorprofile(byte);
     void set_displayenabled(byte);
     void set_focuserpreset(byte, unsigned long);
     void set_webserverport(unsigned long);
@@ -134,9 +161,22 @@ class SetupData
     void set_stallguard(byte);
     void set_tmc2225current(int);
     void set_tmc2209current(int);
+    void set_motoraccel(unsigned long);
+    void set_motormaxspeed(unsigned long);
+    void set_motorvelocity(unsigned long);
+    void set_velocityunit(byte);
+    void set_homesteps(unsigned long);
+    void set_motorspeedthreshold(unsigned long);
+    void set_motorspeedchange(byte);
+    void set_coarsestepmode(int);
+    void set_finesteps(unsigned long);
+    void set_spreadvelocity(unsigned long);
+    void set_coolstep(byte);
+    void set_approachdir(byte);
+    void set_overshoot(unsigned long);
 
     //__getter boardconfig
-    String get_brdname(void);
+    const String &get_brdname(void);            // no copy, comms uses c_str()
     int get_brdmaxstepmode(void);
     int get_brdstepmode(void);
     int get_brdsda(void);
@@ -188,6 +228,11 @@ class SetupData
     void set_stepsperrev(int);
 
   private:
+#if defined(SETUPDATALOCK)
+    SemaphoreHandle_t mutex;
+#endif
+    boolean SaveChanged(unsigned long, byte);
+    boolean CreateBoardConfig(String);
     byte SavePersitantConfiguration();
     byte SaveVariableConfiguration();
     bool WriteBoardConfiguration();
@@ -200,6 +245,7 @@ class SetupData
     void StartDelayedUpdate(unsigned long &, unsigned long);
     void StartDelayedUpdate(float &, float);
     void StartDelayedUpdate(byte &, byte);
+    void StartDelayedUpdate(uint16_t &, uint16_t);
     void StartDelayedUpdate(int &, int);
     void StartDelayedUpdate(String &, String);
 
@@ -228,8 +274,8 @@ class SetupData
     unsigned long maxstep;          // max steps
     float stepsize;                 // the step size in microns, ie 7.2 - value * 10, so real stepsize = stepsize / 10 (maxval = 25.6)
     byte DelayAfterMove;            // delay after movement is finished (maxval=256)
-    byte backlashsteps_in;          // number of backlash steps to apply for IN moves
-    byte backlashsteps_out;         // number of backlash steps to apply for OUT moves
+    uint16_t backlashsteps_in;      // number of backlash steps to apply for IN moves
+    uint16_t backlashsteps_out;     // number of backlash steps to apply for OUT moves
     byte backlash_in_enabled;       // if 1, backlash is enabled for IN movements (lower or -ve moves)
     byte backlash_out_enabled;      // if 1, backlash is enabled for OUT movements (higher or +ve moves)
     byte tempcoefficient;           // steps per degree temperature coefficient value (maxval=255)
@@ -244,6 +290,7 @@ class SetupData
     byte tempcompenabled;           // indicates if temperature compensation is enabled
     byte tcdirection;               // direction in which to apply temperature compensation
     byte motorspeed;                // speed of motor, slow, medium or fast
+    byte motorprofile;              // acceleration profile, trapezoid or s-curve
     byte displayenabled;            // if 1, display is enabled
     unsigned long preset[10];       // focuser presets can be used with software or ir-remote controller
     unsigned long webserverport;
@@ -269,6 +316,19 @@ class SetupData
     byte    stallguard;                // value for STALL_GUARD, tmc2209
     int     tmc2209current;
     int     tmc2225current;
+    unsigned long motoraccel;          // step acceleration steps/s/s, 0 = no ramp
+    unsigned long motormaxspeed;       // cruise speed steps/s, 0 = use board msdelay
+    unsigned long motorvelocity;       // fast motorspeed in velocityunit, 0 = use board msdelay
+    byte    velocityunit;              // 0 = full steps/s, 1 = um/s
+    unsigned long homesteps;           // limit of steps for each homing move
+    unsigned long motorspeedthreshold; // steps before the target where the move changes to slow speed
+    byte    motorspeedchange;          // 1 = change to slow speed near the target
+    int     coarsestepmode;            // step mode of the slew on TMC boards, 0 = no coarse slew
+    unsigned long finesteps;           // steps at the end of a move in the step mode setting
+    unsigned long spreadvelocity;      // tmc SpreadCycle above this velocity in velocityunit, 0 = always StealthChop
+    byte    coolstep;                  // 1 = tmc2209 CoolStep while cruising
+    byte    approachdir;               // every move ends moving in this direction, APPROACH_OFF uses backlash steps
+    unsigned long overshoot;           // steps past the target of moves against the approach direction
 
     // dataset board configuration
     String board;
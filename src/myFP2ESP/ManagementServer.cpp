@@ -19,6 +19,7 @@
 #include "SPIFFS.h"
 #endif
 
+#include <ArduinoJson.h>                    // for movequeue
 #include "displays.h"                       // for myoled
 #include "temp.h"                           // for myTempProbe
 
@@ -30,8 +31,22 @@ extern DriverBoard   *driverboard;
 extern OLED_NON      *myoled;
 extern TempProbe     *myTempProbe;
 
-extern unsigned long ftargetPosition;
-extern byte isMoving;
+extern byte homestate;
+extern byte blcalstate;
+extern byte blcalrep;
+extern uint16_t blcalin[];
+extern uint16_t blcalout[];
+extern byte movequeuecount;
+extern byte movequeueindex;
+extern bool movequeuerun;
+extern TaskLoad motionload;
+extern TaskLoad commsload;
+extern MoveStats movestats;
+#if defined(STEPTRACE)
+extern StepTraceEntry    steptrace[];
+extern volatile uint32_t steptracehead;
+extern volatile bool     steptraceon;
+#endif
 extern int  packetsreceived;
 extern int  packetssent;
 extern bool mdnsserverstate;                       // states for services, RUNNING | STOPPED
@@ -59,6 +74,11 @@ extern void software_Reboot(int);
 extern long getrssi(void);
 extern bool init_leds(void);
 extern bool init_pushbuttons(void);
+extern void motion_command(byte, long);
+extern void motion_queueadd(unsigned long, unsigned long, byte);
+#if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
+extern String tcpclients_json(void);
+#endif
 
 #ifdef MDNSSERVER
 extern void start_mdns_service(void);
@@ -771,7 +791,7 @@ void MANAGEMENT_handleadminpg4(void)
 #endif
 }
 
-// builder for msindex3 - admin page 3 - backlash + motor-speed-delay + push buttons
+// builder for msindex3 - admin page 3 - backlash + motor-speed-delay + tmc driver + push buttons
 void MANAGEMENT_buildadminpg3(void)
 {
 #ifdef TIMEMSBUILDPG3
@@ -823,11 +843,57 @@ void MANAGEMENT_buildadminpg3(void)
     MSpg.replace("%bins%", String(mySetupData->get_backlashsteps_in()));
     MSpg.replace("%bous%", String(mySetupData->get_backlashsteps_out()));
 
+    // backlash calibration on the home position switch, progress and measurements of the last run
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    const char *blcalnames[] = { "Idle", "Seek switch", "Measure out", "Measure in", "Done", "Failed" };
+    String blcstr = "<b>Calibration:</b> " + String(blcalnames[(blcalstate > BLCAL_FAILED) ? BLCAL_FAILED : blcalstate]);
+    if ( blcalstate != BLCAL_IDLE )
+    {
+      blcstr = blcstr + " " + String(blcalrep) + "/" + String(BLCALREPEATS) + "<br>In:";
+      for ( int i = 0; i < blcalrep; i++ )
+      {
+        blcstr = blcstr + " " + String(blcalin[i]);
+      }
+      blcstr = blcstr + ", Out:";
+      for ( int i = 0; (i < BLCALREPEATS) && ((i < blcalrep) || ((i == blcalrep) && (blcalstate == BLCAL_IN))); i++ )
+      {
+        blcstr = blcstr + " " + String(blcalout[i]);
+      }
+    }
+    blcstr = blcstr + "<form action=\"/msindex3\" method=\"post\"><input type=\"hidden\" name=\"blcal\" value=\"true\"><input type=\"submit\" value=\"CALIBRATE\"" + String(( ms.moving == 0 ) ? "" : " disabled") + "></form>";
+    blcstr = blcstr + "<form action=\"/msindex3\" method=\"GET\"><input type=\"submit\" value=\"REFRESH\"></form>";
+    MSpg.replace("%BLC%", blcstr);
+
+    // final approach from one direction instead of backlash steps
+    const char *apnames[] = { "Off", "In", "Out" };
+    String aprstr = "<form action=\"/msindex3\" method=\"post\"><b>Final approach:</b> <select name=\"apd\">";
+    for ( byte i = APPROACH_OFF; i <= APPROACH_OUT; i++ )
+    {
+      aprstr = aprstr + "<option value=\"" + String(i) + "\"" + String(( mySetupData->get_approachdir() == i ) ? " selected" : "") + ">" + String(apnames[i]) + "</option>";
+    }
+    aprstr = aprstr + "</select> Overshoot: <input type=\"text\" name=\"ovs\" size=\"6\" value=" + String(mySetupData->get_overshoot()) + "> <input type=\"submit\" name=\"setapr\" value=\"Set\"></form>";
+    MSpg.replace("%APR%", aprstr);
+
     // motor speed delay
     MSpg.replace("%MS%", "<form action=\"/msindex3\" method=\"post\">Delay: <input type=\"text\" name=\"msd\" size=\"6\" value=" + String(mySetupData->get_brdmsdelay()) + "> <input type=\"submit\" name=\"setmsd\" value=\"Set\"></form>");
 
     MSpg.replace("%BT%", String(CREBOOTSTR));           // add code to handle reboot controller
 
+    // tmc driver mode, read back in the background by the motion loop
+    TmcStatus ts;
+    if ( driverboard->gettmcstatus(ts) == true )
+    {
+      String tmcstr = "<b>Mode:</b> " + String(TMCSTEALTH(ts.drvstatus) ? "StealthChop" : "SpreadCycle") + ", <b>Current scale:</b> " + String(TMCCSACTUAL(ts.drvstatus)) + "/31";
+      tmcstr = tmcstr + "<form action=\"/msindex3\" method=\"post\">SpreadCycle above: <input type=\"text\" name=\"spv\" size=\"6\" value=" + String(mySetupData->get_spreadvelocity()) + "> <input type=\"submit\" name=\"setspv\" value=\"Set\"></form>";
+      tmcstr = tmcstr + "<form action=\"/msindex3\" method=\"post\"><b>CoolStep</b> [" + String(( mySetupData->get_coolstep() == 1 ) ? "Enabled" : "Disabled") + "]: <input type=\"hidden\" name=\"" + String(( mySetupData->get_coolstep() == 1 ) ? "cooloff" : "coolon") + "\" value=\"true\"><input type=\"submit\" value=\"" + String(( mySetupData->get_coolstep() == 1 ) ? "DISABLE" : "ENABLE") + "\"></form>";
+      MSpg.replace("%TMD%", tmcstr);
+    }
+    else
+    {
+      MSpg.replace("%TMD%", "Not a TMC driver board");
+    }
+
     // PUSHBUTTONS
     if ( mySetupData->get_pbenable() == 1)
     {
@@ -858,7 +924,7 @@ void MANAGEMENT_buildadminpg3(void)
   delay(10);                                            // small pause so background tasks can run
 }
 
-// handler for msindex3 - admin page 3 - backlash + motor-speed-delay + push buttons
+// handler for msindex3 - admin page 3 - backlash + motor-speed-delay + tmc driver + push buttons
 void MANAGEMENT_handleadminpg3(void)
 {
 #ifdef TIMEMSHANDLEPG3
@@ -907,8 +973,10 @@ void MANAGEMENT_handleadminpg3(void)
     String st = mserver.arg("bis");
     MSrvr_DebugPrint("adminpg3: bis: ");
     MSrvr_DebugPrintln(st);
-    byte steps = st.toInt();                            // no need to test for <0 and > 255 as it is a byte value
-    mySetupData->set_backlashsteps_in(steps);
+    long steps = st.toInt();
+    steps = ( steps < 0 ) ? 0 : steps;
+    steps = ( steps > MAXBACKLASHSTEPS ) ? MAXBACKLASHSTEPS : steps;
+    mySetupData->set_backlashsteps_in((uint16_t) steps);
   }
 
   // backlash out steps, setbos, bos
@@ -919,8 +987,37 @@ void MANAGEMENT_handleadminpg3(void)
     String st = mserver.arg("bos");
     MSrvr_DebugPrint("adminpg3: bos: ");
     MSrvr_DebugPrintln(st);
-    byte steps = st.toInt();
-    mySetupData->set_backlashsteps_out(steps);
+    long steps = st.toInt();
+    steps = ( steps < 0 ) ? 0 : steps;
+    steps = ( steps > MAXBACKLASHSTEPS ) ? MAXBACKLASHSTEPS : steps;
+    mySetupData->set_backlashsteps_out((uint16_t) steps);
+  }
+
+  // final approach direction and overshoot, setapr, apd, ovs
+  msg = mserver.arg("setapr");
+  if ( msg != "" )
+  {
+    MSrvr_DebugPrintln("adminpg3: setapr: ");
+    long tmp = mserver.arg("apd").toInt();
+    tmp = ( (tmp < APPROACH_OFF) || (tmp > APPROACH_OUT) ) ? APPROACH_OFF : tmp;
+    mySetupData->set_approachdir((byte) tmp);
+    tmp = mserver.arg("ovs").toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXOVERSHOOT ) ? MAXOVERSHOOT : tmp;
+    mySetupData->set_overshoot(tmp);
+  }
+
+  // backlash calibration, blcal, moves to the home position switch
+  msg = mserver.arg("blcal");
+  if ( msg != "" )
+  {
+    MSrvr_DebugPrintln("adminpg3: blcal: ");
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    if ( ms.moving == 0 )
+    {
+      motion_command(MOTION_BLCALIBRATE, 0);
+    }
   }
 
   // motor speed delay
@@ -939,6 +1036,30 @@ void MANAGEMENT_handleadminpg3(void)
     }
   }
 
+  // tmc SpreadCycle velocity and CoolStep
+  msg = mserver.arg("setspv");
+  if ( msg != "" )
+  {
+    String spv = mserver.arg("spv");
+    if ( spv != "" )
+    {
+      long newval = spv.toInt();
+      newval = (newval < 0) ? 0 : newval;
+      newval = (newval > MAXMOTORVELOCITY) ? MAXMOTORVELOCITY : newval;
+      mySetupData->set_spreadvelocity(newval);
+    }
+  }
+  msg = mserver.arg("coolon");
+  if ( msg != "" )
+  {
+    mySetupData->set_coolstep(1);
+  }
+  msg = mserver.arg("cooloff");
+  if ( msg != "" )
+  {
+    mySetupData->set_coolstep(0);
+  }
+
   // push buttons enable/disable
   msg = mserver.arg("pbon");
   if ( msg != "" )
@@ -1495,14 +1616,7 @@ void MANAGEMENT_handleadminpg2(void)
       if ( mySetupData->get_hpswitchenable() == 0)
       {
         mySetupData->set_hpswitchenable(1);
-        if ( driverboard->init_hpsw() == true)
-        {
-          MSrvr_DebugPrintln("hpsw init OK");
-        }
-        else
-        {
-          MSrvr_DebugPrintln("hpsw init NOK");
-        }
+        motion_command(MOTION_INITHPSW, 0);
       }
     }
   }
@@ -1510,6 +1624,7 @@ void MANAGEMENT_handleadminpg2(void)
   if ( msg != "" )
   {
     mySetupData->set_hpswitchenable(0);
+    motion_command(MOTION_INITHPSW, 0);
   }
 
   MANAGEMENT_sendadminpg2();
@@ -1804,12 +1919,12 @@ void MANAGEMENT_handleadminpg1(void)
       if ( msg == "don" )
       {
         mySetupData->set_displayenabled(1);
-        myoled->display_on();
+        motion_command(MOTION_DISPLAYON, 0);
       }
       else
       {
         mySetupData->set_displayenabled(0);
-        myoled->display_off();
+        motion_command(MOTION_DISPLAYOFF, 0);
       }
     }
   }
@@ -2055,8 +2170,8 @@ void MANAGEMENT_sendjson(String str)
 void MANAGEMENT_handleget(void)
 {
   // return json string of state, on or off or value
-  // ascom, boardconfig, coilpower, coilpowertimeout, dataconfig, display, fixedstepmode, hpsw, ismoving,
-  // leds, motorspeed, motorspeeddelay, position, reverse, rssi, tempprobe, tmc2209current, tmc2225current, webserver
+  // approach, ascom, blcalibrate, boardconfig, coarsestepmode, coilpower, coilpowertimeout, dataconfig, display, fixedstepmode, homestate, homesteps, hpsw, ismoving,
+  // leds, motoraccel, motormaxspeed, motorprofile, motorspeed, motorspeeddelay, motorvelocity, movequeue, movestats, position, reverse, rssi, spreadvelocity, taskload, tcpclients, tempprobe, tmc2209current, tmc2225current, tmcstatus, webserver
   String jsonstr;
 
   if ( mserver.argName(0) == "ascom" )
@@ -2064,6 +2179,21 @@ void MANAGEMENT_handleget(void)
     jsonstr = "{\"ascomserver\":" + String(mySetupData->get_ascomserverstate()) + " }";
     MANAGEMENT_sendjson(jsonstr);
   }
+  else if ( mserver.argName(0) == "blcalibrate" )
+  {
+    jsonstr = "{ \"blcalstate\":" + String(blcalstate) + ", \"repeats\":" + String(blcalrep) + ", \"in\":[";
+    for ( int i = 0; i < blcalrep; i++ )
+    {
+      jsonstr = jsonstr + String(( i == 0 ) ? "" : ",") + String(blcalin[i]);
+    }
+    jsonstr = jsonstr + "], \"out\":[";
+    for ( int i = 0; i < blcalrep; i++ )
+    {
+      jsonstr = jsonstr + String(( i == 0 ) ? "" : ",") + String(blcalout[i]);
+    }
+    jsonstr = jsonstr + "], \"backlashsteps_in\":" + String(mySetupData->get_backlashsteps_in()) + ", \"backlashsteps_out\":" + String(mySetupData->get_backlashsteps_out()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
   else if ( mserver.argName(0) == "boardconfig" )
   {
     // send board configuration
@@ -2133,7 +2263,9 @@ void MANAGEMENT_handleget(void)
   }
   else if ( mserver.argName(0) == "ismoving" )
   {
-    jsonstr = "{ \"ismoving\":" + String(isMoving) + " }";
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    jsonstr = "{ \"ismoving\":" + String(ms.moving) + " }";
     MANAGEMENT_sendjson(jsonstr);
   }
   else if ( mserver.argName(0) == "leds" )
@@ -2151,6 +2283,75 @@ void MANAGEMENT_handleget(void)
     jsonstr = "{ \"motorspeeddelay\":" + String(mySetupData->get_brdmsdelay()) + " }";
     MANAGEMENT_sendjson(jsonstr);
   }
+  else if ( mserver.argName(0) == "movequeue" )
+  {
+    jsonstr = "{ \"segment\":" + String(movequeueindex) + ", \"count\":" + String(movequeuecount) + ", \"running\":" + String(movequeuerun) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "approach" )
+  {
+    jsonstr = "{ \"approachdir\":" + String(mySetupData->get_approachdir()) + ", \"overshoot\":" + String(mySetupData->get_overshoot()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "movestats" )
+  {
+    jsonstr = "{ \"moves\":" + String(movestats.moves) + ", \"steps\":" + String(movestats.steps) + ", \"backlash\":" + String(movestats.backlash) + ", \"overshoot\":" + String(movestats.overshoot) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+#if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
+  else if ( mserver.argName(0) == "tcpclients" )
+  {
+    jsonstr = "{ \"clients\":" + tcpclients_json() + ", \"max\":" + String(TCPCLIENTS) + ", \"received\":" + String(packetsreceived) + ", \"sent\":" + String(packetssent) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+#endif
+  else if ( mserver.argName(0) == "taskload" )
+  {
+    jsonstr = "{ \"motion\":" + String(motionload.load) + ", \"comms\":" + String(commsload.load) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "homesteps" )
+  {
+    jsonstr = "{ \"homesteps\":" + String(mySetupData->get_homesteps()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "homestate" )
+  {
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    jsonstr = "{ \"homestate\":" + String(homestate) + ", \"position\":" + String(ms.position) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "motoraccel" )
+  {
+    jsonstr = "{ \"motoraccel\":" + String(mySetupData->get_motoraccel()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "motormaxspeed" )
+  {
+    jsonstr = "{ \"motormaxspeed\":" + String(mySetupData->get_motormaxspeed()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "motorprofile" )
+  {
+    jsonstr = "{ \"motorprofile\":" + String(mySetupData->get_motorprofile()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "coarsestepmode" )
+  {
+    jsonstr = "{ \"coarsestepmode\":" + String(mySetupData->get_coarsestepmode()) + ", \"stepmode\":" + String(mySetupData->get_brdstepmode()) + ", \"finesteps\":" + String(mySetupData->get_finesteps()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "spreadvelocity" )
+  {
+    jsonstr = "{ \"spreadvelocity\":" + String(mySetupData->get_spreadvelocity()) + ", \"coolstep\":" + String(mySetupData->get_coolstep()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
+  else if ( mserver.argName(0) == "motorvelocity" )
+  {
+    jsonstr = "{ \"motorvelocity\":" + String(mySetupData->get_motorvelocity()) + ", \"unit\":" + String(mySetupData->get_velocityunit()) + " }";
+    MANAGEMENT_sendjson(jsonstr);
+  }
   else if ( mserver.argName(0) == "position" )
   {
     jsonstr = "{ \"position\":" + String(mySetupData->get_fposition()) + " }";
@@ -2175,7 +2376,7 @@ void MANAGEMENT_handleget(void)
   else if ( mserver.argName(0) == "stallguard" )
   {
     byte sgval = STALL_VALUE;                     // we must set it to something in case the next lines are not enabled
-    sgval = driverboard->getstallguard();
+    sgval = driverboard->getstallguard();         // register value, scaled for the motorspeed of the last move
     jsonstr = "{ \"stallguard\":" + String(mySetupData->get_stallguard()) + ", \"tmc2209sg\":" + String(sgval) + " }";
     MANAGEMENT_sendjson(jsonstr);
   }
@@ -2194,6 +2395,20 @@ void MANAGEMENT_handleget(void)
     jsonstr = "{\"tmc2225current\":" + String(mySetupData->get_tmc2225current()) + " }";
     MANAGEMENT_sendjson(jsonstr);
   }
+  else if ( mserver.argName(0) == "tmcstatus" )
+  {
+    TmcStatus ts;
+    if ( driverboard->gettmcstatus(ts) == true )
+    {
+      jsonstr = "{ \"drvstatus\":" + String(ts.drvstatus) + ", \"mode\":\"" + String(TMCSTEALTH(ts.drvstatus) ? "stealthchop" : "spreadcycle") + "\", \"csactual\":" + String(TMCCSACTUAL(ts.drvstatus));
+      jsonstr = jsonstr + ", \"tpwmthrs\":" + String(ts.tpwmthrs) + ", \"sgresult\":" + String(ts.sgresult) + ", \"writes\":" + String(ts.writes) + ", \"skipped\":" + String(ts.skipped) + ", \"reads\":" + String(ts.reads) + " }";
+    }
+    else
+    {
+      jsonstr = "{ \"tmcstatus\":\"none\" }";
+    }
+    MANAGEMENT_sendjson(jsonstr);
+  }
   else if ( mserver.argName(0) == "webserver" )
   {
     jsonstr = "{\"webserver\":" + String(mySetupData->get_webserverstate()) + " }";
@@ -2230,8 +2445,8 @@ void MANAGEMENT_handleset(void)
   String jsonstr;
   String value;
   String drvbrd = mySetupData->get_brdname();
-  // ascom, coilpower, coilpowertimeout, display, fixedstepmode, hpsw, leds, motorspeed, motorspeeddelay,
-  // move, position, reverse, stepmode, tempprobe, tmc2209current, tmc2225current, webserver,
+  // approachdir, ascom, blcalibrate, coarsestepmode, coilpower, coilpowertimeout, coolstep, display, finesteps, findhome, fixedstepmode, homesteps, hpsw, leds, motoraccel, motormaxspeed, motorprofile, motorspeed, motorspeeddelay,
+  // motorvelocity, move, movequeue, overshoot, position, reverse, stepmode, tempprobe, tmc2209current, tmc2225current, spreadvelocity, velocityunit, webserver,
 
   // ascom remote server
   value = mserver.arg("ascom");
@@ -2278,13 +2493,13 @@ void MANAGEMENT_handleset(void)
     if ( value == "on" )
     {
       mySetupData->set_coilpower(1);
-      driverboard->enablemotor();
+      motion_command(MOTION_COILPOWER, 1);
       jsonstr = "{ \"coilpower\":\"on\" }";
     }
     else if ( value == "off" )
     {
       mySetupData->set_coilpower(0);
-      driverboard->releasemotor();
+      motion_command(MOTION_COILPOWER, 0);
       jsonstr = "{ \"coilpower\":\"off\" }";
     }
   }
@@ -2310,7 +2525,7 @@ void MANAGEMENT_handleset(void)
       {
         MSrvr_DebugPrintln("display: ON");
         mySetupData->set_displayenabled(1);
-        myoled->display_on();
+        motion_command(MOTION_DISPLAYON, 0);
         jsonstr = "{ \"display\":\"on\" }";
       }
       else if ( value == "off" )
@@ -2319,7 +2534,7 @@ void MANAGEMENT_handleset(void)
         if ( mySetupData->get_displayenabled() == 1)
         {
           mySetupData->set_displayenabled(0);
-          myoled->display_off();
+          motion_command(MOTION_DISPLAYOFF, 0);
         }
         else
         {
@@ -2359,19 +2574,13 @@ void MANAGEMENT_handleset(void)
       if ( value == "on" )
       {
         mySetupData->set_hpswitchenable(1);
-        if ( driverboard->init_hpsw() == true)
-        {
-          MSrvr_DebugPrintln("hpsw init OK");
-        }
-        else
-        {
-          MSrvr_DebugPrintln("hpsw init NOK");
-        }
+        motion_command(MOTION_INITHPSW, 0);
         jsonstr = "{ \"hpsw\":\"on\" }";
       }
       else if ( value == "off" )
       {
         mySetupData->set_hpswitchenable(0);
+        motion_command(MOTION_INITHPSW, 0);
         jsonstr = "{ \"hpsw\":\"off\" }";
       }
     }
@@ -2453,6 +2662,218 @@ void MANAGEMENT_handleset(void)
     jsonstr = "{ \"motorspeeddelay\":\"" + String(tmp) + " }";
   }
 
+  // backlash calibration - measure backlash in and out on the home position switch, then find home
+  value = mserver.arg("blcalibrate");
+  if ( value != "" )
+  {
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    bool start = ( ms.moving == 0 );
+    if ( start == true )
+    {
+      MSrvr_DebugPrintln("Backlash calibration");
+      motion_command(MOTION_BLCALIBRATE, 0);
+    }
+    jsonstr = "{ \"blcalibrate\":" + String(start) + " }";
+  }
+
+  // find home - seek the home position switch and set position 0
+  value = mserver.arg("findhome");
+  if ( value != "" )
+  {
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    bool start = ( ms.moving == 0 );
+    if ( start == true )
+    {
+      MSrvr_DebugPrintln("Find home");
+      motion_command(MOTION_FINDHOME, 0);
+    }
+    jsonstr = "{ \"findhome\":" + String(start) + " }";
+  }
+
+  // move queue - json array of segments [{"pos":5000,"dwell":500,"speed":2},{"pos":5200}], dwell [ms] and speed 0-2 are optional
+  value = mserver.arg("movequeue");
+  if ( value != "" )
+  {
+    byte segments = 0;
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    if ( ms.moving == 0 )                           // for the reply, the motion task ignores the load if a move has started since
+    {
+      DynamicJsonDocument doc_mq(MOVEQUEUEDOCSIZE);
+      DeserializationError error = deserializeJson(doc_mq, value);
+      if ( !error )
+      {
+        motion_command(MOTION_QUEUECLEAR, 0);
+        for ( JsonObject seg : doc_mq.as<JsonArray>() )
+        {
+          if ( segments == MOVEQUEUESIZE )
+          {
+            break;                                  // queue full, ignore the rest
+          }
+          long pos = seg["pos"] | 0L;               // a negative position or dwell is 0
+          long dwell = seg["dwell"] | 0L;
+          motion_queueadd(( pos < 0 ) ? 0 : pos, ( dwell < 0 ) ? 0 : dwell, seg["speed"] | MOVESPEEDSETTING);
+          segments++;
+        }
+        motion_command(MOTION_RUNQUEUE, 0);
+      }
+      else
+      {
+        MSrvr_DebugPrintln("movequeue: json error");
+      }
+    }
+    jsonstr = "{ \"movequeue\":" + String(segments) + " }";
+  }
+
+  // limit of steps for each homing move
+  value = mserver.arg("homesteps");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXHOMESTEPS ) ? MAXHOMESTEPS : tmp;
+    tmp = ( tmp < 1 ) ? HOMESTEPS : tmp;
+    MSrvr_DebugPrint("Homesteps: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_homesteps(tmp);
+    jsonstr = "{ \"homesteps\":" + String(tmp) + " }";
+  }
+
+  // motor acceleration steps/s/s, 0 = no ramp
+  value = mserver.arg("motoraccel");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXMOTORACCEL ) ? MAXMOTORACCEL : tmp;
+    MSrvr_DebugPrint("Motoraccel: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_motoraccel(tmp);
+    jsonstr = "{ \"motoraccel\":" + String(tmp) + " }";
+  }
+
+  // motor cruise speed steps/s, 0 = use motorspeeddelay
+  value = mserver.arg("motormaxspeed");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXMOTORMAXSPEED ) ? MAXMOTORMAXSPEED : tmp;
+    MSrvr_DebugPrint("Motormaxspeed: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_motormaxspeed(tmp);
+    jsonstr = "{ \"motormaxspeed\":" + String(tmp) + " }";
+  }
+
+  // motor acceleration profile, 0 = trapezoid, 1 = s-curve
+  value = mserver.arg("motorprofile");
+  if ( value != "" )
+  {
+    int tmp = value.toInt();
+    tmp = ( tmp == PROFILE_SCURVE ) ? PROFILE_SCURVE : PROFILE_TRAPEZOID;
+    MSrvr_DebugPrint("Motorprofile: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_motorprofile(tmp);
+    jsonstr = "{ \"motorprofile\":" + String(tmp) + " }";
+  }
+
+  // step mode of the slew on TMC boards, 0 = no coarse slew
+  value = mserver.arg("coarsestepmode");
+  if ( value != "" )
+  {
+    int tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > STEP256 ) ? STEP256 : tmp;
+    MSrvr_DebugPrint("Coarsestepmode: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_coarsestepmode(tmp);
+    jsonstr = "{ \"coarsestepmode\":" + String(tmp) + " }";
+  }
+
+  // steps at the end of a move in the fine step mode
+  value = mserver.arg("finesteps");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXFINESTEPS ) ? MAXFINESTEPS : tmp;
+    MSrvr_DebugPrint("Finesteps: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_finesteps(tmp);
+    jsonstr = "{ \"finesteps\":" + String(tmp) + " }";
+  }
+
+  // tmc SpreadCycle above this velocity in velocityunit, 0 = always StealthChop
+  value = mserver.arg("spreadvelocity");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXMOTORVELOCITY ) ? MAXMOTORVELOCITY : tmp;
+    MSrvr_DebugPrint("Spreadvelocity: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_spreadvelocity(tmp);
+    jsonstr = "{ \"spreadvelocity\":" + String(tmp) + " }";
+  }
+
+  // final approach direction, 0 = off use backlash steps, 1 = in, 2 = out
+  value = mserver.arg("approachdir");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( (tmp < APPROACH_OFF) || (tmp > APPROACH_OUT) ) ? APPROACH_OFF : tmp;
+    mySetupData->set_approachdir((byte) tmp);
+    jsonstr = "{ \"approachdir\":" + String(tmp) + " }";
+  }
+
+  // steps past the target of moves against the final approach direction
+  value = mserver.arg("overshoot");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXOVERSHOOT ) ? MAXOVERSHOOT : tmp;
+    MSrvr_DebugPrint("Overshoot: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_overshoot(tmp);
+    jsonstr = "{ \"overshoot\":" + String(tmp) + " }";
+  }
+
+  // tmc2209 CoolStep while cruising, on | off
+  value = mserver.arg("coolstep");
+  if ( value != "" )
+  {
+    mySetupData->set_coolstep( (value == "on") ? 1 : 0 );
+    jsonstr = "{ \"coolstep\":" + String(mySetupData->get_coolstep()) + " }";
+  }
+
+  // motor velocity for the fast motorspeed, in full steps/s or um/s, 0 = use motorspeeddelay
+  value = mserver.arg("motorvelocity");
+  if ( value != "" )
+  {
+    long tmp = value.toInt();
+    tmp = ( tmp < 0 ) ? 0 : tmp;
+    tmp = ( tmp > MAXMOTORVELOCITY ) ? MAXMOTORVELOCITY : tmp;
+    MSrvr_DebugPrint("Motorvelocity: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_motorvelocity(tmp);
+    jsonstr = "{ \"motorvelocity\":" + String(tmp) + " }";
+  }
+
+  // motor velocity unit, 0 = full steps/s, 1 = um/s
+  value = mserver.arg("velocityunit");
+  if ( value != "" )
+  {
+    int tmp = value.toInt();
+    tmp = ( tmp == VELOCITY_MICRONS ) ? VELOCITY_MICRONS : VELOCITY_FULLSTEPS;
+    MSrvr_DebugPrint("Velocityunit: ");
+    MSrvr_DebugPrintln(tmp);
+    mySetupData->set_velocityunit(tmp);
+    jsonstr = "{ \"velocityunit\":" + String(tmp) + " }";
+  }
+
   // move - moves focuser position
   value = mserver.arg("move");
   if ( value != "" )
@@ -2460,8 +2881,9 @@ void MANAGEMENT_handleset(void)
     unsigned long temp = value.toInt();
     MSrvr_DebugPrint("Move to position: ");
     MSrvr_DebugPrintln(temp);
-    ftargetPosition = ( temp > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : temp;
-    jsonstr = "{ \"move\":" + String(ftargetPosition) + " }";
+    temp = ( temp > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : temp;
+    motion_command(MOTION_MOVE, temp);
+    jsonstr = "{ \"move\":" + String(temp) + " }";
   }
 
   // position - does not move focuser
@@ -2471,10 +2893,9 @@ void MANAGEMENT_handleset(void)
     unsigned long temp = value.toInt();
     MSrvr_DebugPrint("Set position: ");
     MSrvr_DebugPrintln(temp);
-    ftargetPosition = ( temp > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : temp;
-    mySetupData->set_fposition(ftargetPosition);      // current position in SPIFFS
-    driverboard->setposition(ftargetPosition);        // current position in driver board
-    jsonstr = "{ \"position\":" + String(ftargetPosition) + " }";
+    temp = ( temp > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : temp;
+    motion_command(MOTION_SETPOSITION, temp);         // current position in driver board and SPIFFS
+    jsonstr = "{ \"position\":" + String(temp) + " }";
   }
 
   // reversedirection
@@ -2499,11 +2920,10 @@ void MANAGEMENT_handleset(void)
   value = mserver.arg("stallguard");
   if ( value != "" )
   {
-    int temp = value.toInt();
+    byte temp = (byte) value.toInt();
     MSrvr_DebugPrint("stallguard: ");
     MSrvr_DebugPrintln(temp);
-    driverboard->setstallguard((byte) temp);      // write to registers and update mySetupData
-    temp = mySetupData->get_stallguard();
+    motion_command(MOTION_STALLGUARD, temp);      // motion task writes to registers and updates mySetupData
     jsonstr = "{ \"stallguard\":" + String(temp) + ",  }";
   }
 
@@ -2514,8 +2934,7 @@ void MANAGEMENT_handleset(void)
     int temp = value.toInt();
     MSrvr_DebugPrint("stepmode: ");
     MSrvr_DebugPrintln(temp);
-    driverboard->setstepmode(temp);                     // write to pins and update mySetupData
-    temp = mySetupData->get_brdstepmode();              // read actual stepmode set by driverboard
+    motion_command(MOTION_STEPMODE, temp);              // motion task writes to pins and updates mySetupData
     jsonstr = "{ \"stepmode\":" + String(temp) + " }";
   }
 
@@ -2569,7 +2988,7 @@ void MANAGEMENT_handleset(void)
     int temp = value.toInt();
     MSrvr_DebugPrint("tmc2209current: ");
     MSrvr_DebugPrintln(temp);
-    driverboard->settmc2209current(temp);   // write current value to tmc22xx, call mySetupData->set_tmc2209current(temp);
+    motion_command(MOTION_TMC2209CURRENT, temp);    // motion task writes current value to tmc22xx, calls mySetupData->set_tmc2209current(temp);
     jsonstr = "{ \"tmc2209current\":" + String(temp) + " }";
   }
 
@@ -2580,7 +2999,7 @@ void MANAGEMENT_handleset(void)
     int temp = value.toInt();
     MSrvr_DebugPrint("tmc2225current: ");
     MSrvr_DebugPrintln(temp);
-    driverboard->settmc2225current(temp);   // write current value to tmc22xx, call mySetupData->set_tmc2225current(temp);
+    motion_command(MOTION_TMC2225CURRENT, temp);    // motion task writes current value to tmc22xx, calls mySetupData->set_tmc2225current(temp);
     jsonstr = "{ \"tmc2225current\":" + String(temp) + " }";
   }
 
@@ -2644,6 +3063,64 @@ void MANAGEMENT_rssi(void)
   mserver.send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, String(rssi) );
 }
 
+#if defined(STEPTRACE)
+// download the step trace ring of the timer ISR, oldest entry first, recording is paused while the ring is read
+// /steptrace        csv, index,cycles,delta_us,dir,backlash,hpsw,end,stepcount
+// /steptrace?bin    binary, "STR1", cpu MHz, count [uint32 little endian] then count entries of cycles, info [uint32]
+// /steptrace?clear  empty the ring
+void MANAGEMENT_steptrace(void)
+{
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  steptraceon = false;
+  uint32_t count = ( steptracehead < STEPTRACESIZE ) ? steptracehead : STEPTRACESIZE;
+  uint32_t first = (steptracehead - count) & (STEPTRACESIZE - 1);
+
+  if ( mserver.hasArg("clear") )
+  {
+    steptracehead = 0;
+    mserver.send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, "cleared");
+  }
+  else if ( mserver.hasArg("bin") )
+  {
+    uint32_t header[3] = { 0x31525453, mhz, count };         // "STR1"
+    // the ring may have wrapped, send it in two parts
+    uint32_t part = ( (first + count) > STEPTRACESIZE ) ? STEPTRACESIZE - first : count;
+    mserver.setContentLength(sizeof(header) + count * sizeof(StepTraceEntry));
+    mserver.send(NORMALWEBPAGE, "application/octet-stream", "");
+    mserver.sendContent_P((const char *) header, sizeof(header));
+    mserver.sendContent_P((const char *) &steptrace[first], part * sizeof(StepTraceEntry));
+    if ( part < count )
+    {
+      mserver.sendContent_P((const char *) &steptrace[0], (count - part) * sizeof(StepTraceEntry));
+    }
+  }
+  else
+  {
+    mserver.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    mserver.send(NORMALWEBPAGE, "text/csv", "index,cycles,delta_us,dir,backlash,hpsw,end,stepcount\n");
+    String lines = "";
+    uint32_t lastcycles = steptrace[first].cycles;
+    for ( uint32_t lp = 0; lp < count; lp++ )
+    {
+      StepTraceEntry e = steptrace[(first + lp) & (STEPTRACESIZE - 1)];
+      lines += String(lp) + "," + String(e.cycles) + "," + String((e.cycles - lastcycles) / mhz) + ",";
+      lines += String((e.info & TRACE_OUT) ? 1 : 0) + "," + String((e.info & TRACE_BACKLASH) ? 1 : 0) + ",";
+      lines += String((e.info & TRACE_HPSW) ? 1 : 0) + "," + String((e.info & TRACE_END) ? 1 : 0) + ",";
+      lines += String(e.info & TRACE_STEPMASK) + "\n";
+      lastcycles = e.cycles;
+      if ( lines.length() > 1024 )                          // send in chunks to keep the heap small
+      {
+        mserver.sendContent(lines);
+        lines = "";
+      }
+    }
+    mserver.sendContent(lines);
+    mserver.sendContent("");                                // end of chunked reply
+  }
+  steptraceon = true;
+}
+#endif
+
 // reboot controller
 void MANAGEMENT_reboot(void)
 {
@@ -3131,6 +3608,9 @@ void start_management(void)
   mserver.on("/upload",   HTTP_GET,  MANAGEMENT_fileupload);
   mserver.on("/mssuccess",           MANAGEMENT_fileuploadsuccess);
   mserver.on("/rssi",     HTTP_GET,  MANAGEMENT_rssi);
+#if defined(STEPTRACE)
+  mserver.on("/steptrace", HTTP_GET, MANAGEMENT_steptrace);             // step timing trace of the timer ISR
+#endif
   mserver.on("/set",                 MANAGEMENT_handleset);               // generic set function
   mserver.on("/get",                 MANAGEMENT_handleget);               // generic get function
 
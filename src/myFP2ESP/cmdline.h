@@ -0,0 +1,81 @@
+// ======================================================================
+// cmdline.h : myFP2ESP COMMAND LINE ASSEMBLY AND PARSE
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+#ifndef cmdline_h
+#define cmdline_h
+
+#include <Arduino.h>
+#include "generalDefinitions.h"                   // CMDBUFSIZE, STARTCMDSTR, EOFSTR
+
+// ======================================================================
+// CMDLINE : one command assembled from the bytes of a client as they arrive
+// ======================================================================
+// A partial command is kept until more bytes come. The start character begins a new command, so anything
+// before it is discarded, and line ends and nulls are ignored. A command longer than line is dropped when
+// its terminator arrives, and the next start character resyncs. No client is used here, see
+// tcpclient_readline() in myFP2ESP.ino
+struct CmdLine
+{
+  char          line[CMDBUFSIZE];                 // command being received from the start character, terminator not stored
+  size_t        len;                              // chars in line, 0 = waiting for a start character
+  bool          toolong;                          // command is longer than line, it is dropped at the terminator
+  int           dropped;                          // commands dropped, too long
+
+  void reset(void)
+  {
+    len = 0;
+    toolong = false;
+  }
+
+  // add a received byte, returns true when line holds a complete command
+  bool put(char c)
+  {
+    if ( c == STARTCMDSTR )
+    {
+      line[0] = STARTCMDSTR;                      // resync, a new command starts here
+      len = 1;
+      toolong = false;
+    }
+    else if ( (len == 0) || (c == '\r') || (c == '\n') || (c == '\0') )
+    {
+      // no command started, or a line end, ignore
+    }
+    else if ( c == EOFSTR )
+    {
+      bool complete = ( toolong == false );
+      if ( complete == false )
+      {
+        dropped++;
+      }
+      line[len] = '\0';
+      len = 0;
+      toolong = false;
+      return complete;
+    }
+    else if ( len < CMDBUFSIZE - 1 )
+    {
+      line[len++] = c;
+    }
+    else
+    {
+      toolong = true;
+    }
+    return false;
+  }
+};
+
+// ======================================================================
+// CMD_PARSE : command number and parameter of a received command
+// ======================================================================
+// line is :nnparam, len chars, terminator removed. The parameter points into line, "" if there is none
+inline byte cmd_parse(const char *line, size_t len, const char **param)
+{
+  char cmdstr[3] = { (len > 1) ? line[1] : '\0', (len > 2) ? line[2] : '\0', '\0' };
+  *param = (len > 3) ? &line[3] : "";
+  return (byte) atoi(cmdstr);
+}
+
+#endif // #ifndef cmdline_h
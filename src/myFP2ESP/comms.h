@@ -9,6 +9,7 @@
 
 #include "generalDefinitions.h"
 #include "focuserconfig.h"                      // boarddefs.h included as part of focuserconfig.h"
+#include "cmdline.h"                            // cmd_parse()
 
 // ======================================================================
 // EXTERNS
@@ -24,7 +25,10 @@ extern portMUX_TYPE  halt_alertMux;
 
 extern OLED_NON *myoled;
 
-extern byte          isMoving;
+extern byte          homestate;
+extern byte          movequeuecount;
+extern byte          movequeueindex;
+extern bool          movequeuerun;
 extern char          ipStr[];
 extern int           tprobe1;
 extern float         lasttemp;
@@ -37,7 +41,7 @@ extern DriverBoard   *driverboard;
 extern TempProbe     *myTempProbe;
 
 #if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
-extern WiFiClient myclient;                     // only one client supported, multiple connections denied
+extern TcpClient    *tcpclient;                 // client of the command being processed
 #endif // #if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
 
 // extern functions
@@ -49,11 +53,12 @@ extern void  stop_webserver();
 extern long  getrssi(void);
 extern bool  init_leds(void);
 extern bool  init_pushbuttons(void);
+extern void  motion_command(byte, long);
+extern void  motion_queueadd(unsigned long, unsigned long, byte);
 
 // ======================================================================
 // DATA
 // ======================================================================
-String board_data;
 unsigned long presets[10];
 
 // ======================================================================
@@ -90,7 +95,8 @@ void SendMessage(const char *str)
   Comms_DebugPrint("Send:");
   Comms_DebugPrintln(str);
 #if ( (CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE) )  // for Accesspoint or Station mode
-  myclient.print(str);
+  tcpclient->send(str);                               // sent by comms_loop() at the end of the pass
+  tcpclient->packetssent++;
   packetssent++;
 #elif (CONTROLLERMODE == BLUETOOTHMODE)  // for bluetooth
   SerialBT.print(str);
@@ -99,14 +105,6 @@ void SendMessage(const char *str)
 #endif
 }
 
-void SendPaket(const char token, String str, bool bigstr)
-{
-  char mbuffer[320];
-  board_data.toCharArray(mbuffer, board_data.length() + 1);
-  //snprintf(buffer, sizeof(buffer), "%c%s%c", token,  str, EOFSTR);
-  SendMessage(mbuffer);
-}
-
 void SendPaket(const char token, const char *str)
 {
   char mbuffer[32];
@@ -157,33 +155,46 @@ void SendPaket(const char token, const float val, int i)    // i => decimal plac
 void ESP_Communication()
 {
   byte cmdval;
-  String receiveString = "";
-  String WorkString = "";
+  char receiveString[CMDBUFSIZE];                         // :nnparam, terminator removed, no heap allocation
+  size_t len;
   long paramval = 0;
-  String drvbrd = mySetupData->get_brdname();
 
-#if (CONTROLLERMODE == BLUETOOTHMODE)
-  receiveString = STARTCMDSTR + queue.pop();
-#elif (CONTROLLERMODE == LOCALSERIAL)
-  receiveString = STARTCMDSTR + queue.pop();
+#if (CONTROLLERMODE == BLUETOOTHMODE) || (CONTROLLERMODE == LOCALSERIAL)
+  receiveString[0] = STARTCMDSTR;
+  len = 1 + queue.pop(&receiveString[1], sizeof(receiveString) - 1);
 #else   // for Accesspoint or Station mode
+  // comms_loop() has assembled the command of tcpclient, commands longer than the buffer were dropped
+  tcpclient->packetsreceived++;
   packetsreceived++;
-  receiveString = myclient.readStringUntil(EOFSTR);       // read until terminator
+  len = strlen(tcpclient->cmd.line);
+  memcpy(receiveString, tcpclient->cmd.line, len + 1);
 #endif
+  receiveString[len] = '\0';
 
-  receiveString += EOFSTR;                                // put back terminator
-  String cmdstr = receiveString.substring(1, 3);
-  cmdval = cmdstr.toInt();                                // convert command to an integer
-  Comms_DebugPrint("recstr=" + receiveString + "  ");
-  Comms_DebugPrintln("cmdstr=" + cmdstr);
+  // the switch below is the dispatch table, the command numbers are dense so it compiles to a jump
+  // table, test_comms in Test-Programs/HOST-TESTS measures it against a sorted handler table
+  const char *param;                                      // parameter of set commands
+  cmdval = cmd_parse(receiveString, len, &param);
+  Comms_DebugPrint("recstr=");
+  Comms_DebugPrint(receiveString);
+  Comms_DebugPrint("  cmdval=");
+  Comms_DebugPrintln(cmdval);
   switch (cmdval)
   {
     // all the get values first followed by set values
     case 0: // get focuser position
-      SendPaket('P', driverboard->getposition());
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        SendPaket('P', ms.position);
+      }
       break;
     case 1: // ismoving
-      SendPaket('I', isMoving);
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        SendPaket('I', ms.moving);
+      }
       break;
     case 2: // get controller status
       SendPaket('E', "OK");
@@ -194,37 +205,34 @@ void ESP_Communication()
     case 4: // get firmware name
       {
         char buffer[32];
-        char tempstr[20];
-        String brdname = mySetupData->get_brdname();
-        brdname.toCharArray(tempstr, brdname.length() + 1);
-        snprintf(buffer, sizeof(buffer), "%s\r\n%s", tempstr, programVersion );
+        snprintf(buffer, sizeof(buffer), "%s\r\n%s", mySetupData->get_brdname().c_str(), programVersion );
         SendPaket('F', buffer);
       }
       break;
     case 5: // :05xxxxxx# None    Set new target position to xxxxxx (and focuser initiates immediate move to xxxxxx)
-      // only if not already moving
-      if ( isMoving == 0 )
+      // if already moving, the running move is redirected to the new target
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        ftargetPosition = (unsigned long)WorkString.toInt();
-        ftargetPosition = (ftargetPosition > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : ftargetPosition;
-        // main loop will update focuser positions
+        unsigned long tpos = (unsigned long)atol(param);
+        tpos = (tpos > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : tpos;
+        motion_command(MOTION_MOVE, tpos);
       }
+      // main loop will update focuser positions
       break;
     case 6: // get temperature
       SendPaket('Z', lasttemp, 3);
       break;
     case 7: // set maxsteps
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        unsigned long tmppos = (unsigned long)WorkString.toInt();
+        unsigned long tmppos = (unsigned long)atol(param);
         delay(5);
         // check to make sure not above largest value for maxstep
         tmppos = (tmppos > FOCUSERUPPERLIMIT) ? FOCUSERUPPERLIMIT : tmppos;
         // check if below lowest set value for maxstep
         tmppos = (tmppos < FOCUSERLOWERLIMIT) ? FOCUSERLOWERLIMIT : tmppos;
         // check to make sure its not less than current focuser position
-        tmppos = (tmppos < driverboard->getposition()) ? driverboard->getposition() : tmppos;
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        tmppos = (tmppos < ms.position) ? ms.position : tmppos;
         mySetupData->set_maxstep(tmppos);
       }
       break;
@@ -238,25 +246,26 @@ void ESP_Communication()
       SendPaket('O', mySetupData->get_coilpower());
       break;
     case 12: // set coil power
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = (byte) WorkString.toInt();
-      ( paramval == 1 ) ? driverboard->enablemotor()    : driverboard->releasemotor();
+      paramval = (byte) atol(param);
+      motion_command(MOTION_COILPOWER, ( paramval == 1 ) ? 1 : 0);
       ( paramval == 1 ) ? mySetupData->set_coilpower(1) : mySetupData->set_coilpower(0);
       break;
     case 13: // get reverse direction setting, 00 off, 01 on
       SendPaket('R', mySetupData->get_reversedirection());
       break;
     case 14: // set reverse direction
-      if ( isMoving == 0 )
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        paramval = (byte) WorkString.toInt();
-        ( paramval == 1 ) ? mySetupData->set_reversedirection(1) : mySetupData->set_reversedirection(0);
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        if ( ms.moving == 0 )
+        {
+          paramval = (byte) atol(param);
+          ( paramval == 1 ) ? mySetupData->set_reversedirection(1) : mySetupData->set_reversedirection(0);
+        }
       }
       break;
     case 15: // set motor speed
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = (byte)WorkString.toInt() & 3;
+      paramval = (byte)atol(param) & 3;
       mySetupData->set_motorspeed((byte) paramval);
       break;
     case 16: // set display to celsius
@@ -268,22 +277,19 @@ void ESP_Communication()
     case 18:
       // :180#    None    set the return of user specified stepsize to be OFF - default
       // :181#    None    set the return of user specified stepsize to be ON - reports what user specified as stepsize
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = (byte)WorkString.toInt();
+      paramval = (byte)atol(param);
       mySetupData->set_stepsizeenabled((byte) (paramval));
       break;
     case 19: // :19xxxx#  None   set the step size value - double type, eg 2.1
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        float tempstepsize = (float)WorkString.toFloat();
+        float tempstepsize = (float)atof(param);
         tempstepsize = (tempstepsize < MINIMUMSTEPSIZE ) ? MINIMUMSTEPSIZE : tempstepsize;
         tempstepsize = (tempstepsize > MAXIMUMSTEPSIZE ) ? MAXIMUMSTEPSIZE : tempstepsize;
         mySetupData->set_stepsize(tempstepsize);
       }
       break;
     case 20: // set the temperature resolution setting for the DS18B20 temperature probe
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = WorkString.toInt();
+      paramval = atol(param);
       mySetupData->set_tempresolution((byte) paramval);
       if ( mySetupData->get_temperatureprobestate() == 1 )    // if temp probe is enabled
       {
@@ -306,15 +312,13 @@ void ESP_Communication()
       SendPaket('Q', mySetupData->get_tempresolution());
       break;
     case 22: // set the temperature compensation value to xxx
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = WorkString.toInt();
+      paramval = atol(param);
       mySetupData->set_tempcoefficient((byte)paramval);
       break;
     case 23: // set the temperature compensation ON (1) or OFF (0)
       if ( mySetupData->get_temperatureprobestate() == 1)
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        paramval = (byte)WorkString.toInt();
+        paramval = (byte)atol(param);
         mySetupData->set_tempcompenabled((byte) (paramval));
       }
       break;
@@ -335,24 +339,21 @@ void ESP_Communication()
       SendPaket('B', mySetupData->get_tempcoefficient());
       break;
     case 27: // stop a move - like a Halt
-      varENTER_CRITICAL(&halt_alertMux);
-      halt_alert = true;
-      varEXIT_CRITICAL(&halt_alertMux);
+      motion_command(MOTION_HALT, 0);
       break;
     case 28: // home the motor to position 0
-      ftargetPosition = 0; // if this is a home then set target to 0
+      motion_command(MOTION_MOVE, 0); // if this is a home then set target to 0
       break;
     case 29: // get stepmode
       SendPaket('S', mySetupData->get_brdstepmode());
       break;
     // ======================================================================
     // Basic rule for setting stepmode
-    // Set driverboard->setstepmode(xx);                 // this sets the physical pins and saves new stepmode
+    // Send motion_command(MOTION_STEPMODE, xx);          // the motion task sets the physical pins and saves new stepmode
     // ======================================================================
     case 30: // set step mode
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        paramval = WorkString.toInt();
+        paramval = atol(param);
         int brdnum = mySetupData->get_brdnumber();
         if (brdnum == PRO2EULN2003 || brdnum == PRO2EL298N || brdnum == PRO2EL293DMINI || brdnum == PRO2EL9110S)
         {
@@ -386,19 +387,18 @@ void ESP_Communication()
           Comms_DebugPrintln(brdnum);
         }
       }
-      driverboard->setstepmode((int)paramval);
+      motion_command(MOTION_STEPMODE, paramval);
       break;
     case 31: // set focuser position
-      if ( isMoving == 0 )
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        if ( ms.moving == 0 )
         {
-          long tpos = (long)WorkString.toInt();
+          long tpos = (long)atol(param);
           tpos = (tpos < 0) ? 0 : tpos;
           unsigned long tmppos = ((unsigned long) tpos > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : (unsigned long) tpos;
-          ftargetPosition = tmppos;
-          driverboard->setposition(tmppos);
-          mySetupData->set_fposition(tmppos);
+          motion_command(MOTION_SETPOSITION, tmppos);
         }
       }
       break;
@@ -412,8 +412,7 @@ void ESP_Communication()
       SendPaket('X', mySetupData->get_oledpagetime());
       break;
     case 35: // set length of time an oledpage is displayed for in seconds
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = WorkString.toInt();
+      paramval = atol(param);
       if ( paramval < OLEDPAGETIMEMIN )
       {
         paramval = OLEDPAGETIMEMIN;
@@ -429,21 +428,20 @@ void ESP_Communication()
       // :361#    None    Enable Display
       if ( displaystate == true )
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        paramval = (byte) WorkString.toInt();
+        paramval = (byte) atol(param);
         mySetupData->set_displayenabled((byte) (paramval));
         if (paramval == 1)
         {
           if ( displayfound == true )
           {
-            myoled->display_on();
+            motion_command(MOTION_DISPLAYON, 0);
           }
         }
         else
         {
           if ( displayfound == true )
           {
-            myoled->display_off();
+            motion_command(MOTION_DISPLAYOFF, 0);
           }
         }
       }
@@ -455,26 +453,36 @@ void ESP_Communication()
       SendPaket('b', mySetupData->get_tempmode());
       break;
     case 39: // get the new motor position (target) XXXXXX
-      SendPaket('N', ftargetPosition);
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        SendPaket('N', ms.target);
+      }
       break;
     case 40: // reset Arduino myFocuserPro2E controller
       software_Reboot(2000);      // reboot with 2s delay
       break;
     case 42: // reset focuser defaults
-      if ( isMoving == 0 )
       {
-        mySetupData->SetFocuserDefaults();
-        ftargetPosition = mySetupData->get_fposition();
-        driverboard->setposition(ftargetPosition);
-        mySetupData->set_fposition(ftargetPosition);
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        if ( ms.moving == 0 )
+        {
+          mySetupData->SetFocuserDefaults();
+          motion_command(MOTION_SETPOSITION, mySetupData->get_fposition());
+        }
       }
       break;
     case 43: // get motorspeed
       SendPaket('C', mySetupData->get_motorspeed());
       break;
     case 48: // save settings to FS
-      mySetupData->set_fposition(driverboard->getposition());       // need to save setting
-      mySetupData->SaveNow();                                       // save the focuser settings immediately
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        mySetupData->set_fposition(ms.position);                    // need to save setting
+        mySetupData->SaveNow();                                     // save the focuser settings immediately
+      }
       break;
     case 49: // aXXXXX
       SendPaket('a', "b552efd");
@@ -492,11 +500,19 @@ void ESP_Communication()
     case 51: // return ESP8266Wifi Controller IP Address
       SendPaket('d', ipStr);
       break;
-    case 52: // return ESP32 Controller number of TCP packets sent
+    case 52: // return ESP32 Controller number of TCP packets sent to this client
+#if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
+      SendPaket('e', tcpclient->packetssent);
+#else
       SendPaket('e', packetssent);
+#endif
       break;
-    case 53: // return ESP32 Controller number of TCP packets received
+    case 53: // return ESP32 Controller number of TCP packets received from this client
+#if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
+      SendPaket('f', tcpclient->packetsreceived);
+#else
       SendPaket('f', packetsreceived);
+#endif
       break;
     case 54: // return ESP32 Controller SSID
 #if (CONTROLLERMODE == LOCALSERIAL)
@@ -515,15 +531,13 @@ void ESP_Communication()
     case 56: // set motorspeed delay for current speed setting
       {
         int newdelay = 1000;
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        newdelay = WorkString.toInt();
+        newdelay = atol(param);
         newdelay = (newdelay < 1000) ? 1000 : newdelay;   // ensure it is not too low
         mySetupData->set_brdmsdelay(newdelay);
       }
       break;
     case 61: // set update of position on oled when moving (0=disable, 1=enable)
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = (byte)WorkString.toInt();
+      paramval = (byte)atol(param);
       mySetupData->set_oledupdateonmove((byte) (paramval));
       break;
     case 62: // get update of position on oled when moving (00=disable, 01=enable)
@@ -540,47 +554,49 @@ void ESP_Communication()
       }
       break;
     case 64: // move a specified number of steps
-      if ( isMoving == 0 )
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        long pos = (long)WorkString.toInt() + (long)driverboard->getposition();
-        pos  = (pos < 0) ? 0 : pos;
-        ftargetPosition = ( pos > (long)mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : (unsigned long)pos;
+        // relative to the target, which is the current position if not moving
+        motion_command(MOTION_MOVEBY, atol(param));
       }
       break;
     case 71: // set DelayAfterMove in milliseconds
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      mySetupData->set_DelayAfterMove((byte)WorkString.toInt());
+      mySetupData->set_DelayAfterMove((byte)atol(param));
       break;
     case 72: // get DelayAfterMove
       SendPaket('3', mySetupData->get_DelayAfterMove());
       break;
     case 73: // Disable/enable backlash IN (going to lower focuser position)
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = (byte)WorkString.toInt();
+      paramval = (byte)atol(param);
       mySetupData->set_backlash_in_enabled((byte) (paramval));
       break;
     case 74: // get backlash in enabled status
       SendPaket('4', mySetupData->get_backlash_in_enabled());
       break;
     case 75: // Disable/enable backlash OUT (going to lower focuser position)
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = (byte)WorkString.toInt();
+      paramval = (byte)atol(param);
       mySetupData->set_backlash_out_enabled((byte) (paramval));
       break;
     case 76: // get backlash OUT enabled status
       SendPaket('5', mySetupData->get_backlash_out_enabled());
       break;
     case 77: // set backlash in steps
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      mySetupData->set_backlashsteps_in((byte)WorkString.toInt());
+      {
+        long tmp = atol(param);
+        tmp = ( tmp < 0 ) ? 0 : tmp;
+        tmp = ( tmp > MAXBACKLASHSTEPS ) ? MAXBACKLASHSTEPS : tmp;
+        mySetupData->set_backlashsteps_in((uint16_t) tmp);
+      }
       break;
     case 78: // return number of backlash steps IN
       SendPaket('6', mySetupData->get_backlashsteps_in());
       break;
     case 79: // set backlash OUT steps
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      mySetupData->set_backlashsteps_out((byte)WorkString.toInt());
+      {
+        long tmp = atol(param);
+        tmp = ( tmp < 0 ) ? 0 : tmp;
+        tmp = ( tmp > MAXBACKLASHSTEPS ) ? MAXBACKLASHSTEPS : tmp;
+        mySetupData->set_backlashsteps_out((uint16_t) tmp);
+      }
       break;
     case 80: // return number of backlash steps OUT
       SendPaket('7', mySetupData->get_backlashsteps_out());
@@ -589,18 +605,66 @@ void ESP_Communication()
       SendPaket('8', mySetupData->get_stallguard());
       break;
     case 82: // set STALL_VALUE (for TMC2209 stepper modules)
-      WorkString = receiveString.substring(2, receiveString.length() );
-      driverboard->setstallguard( (byte) WorkString.toInt() );
+      motion_command(MOTION_STALLGUARD, (byte) atol(param));
       break;
     case 83: // get if there is a temperature probe
       SendPaket('c', tprobe1);
       break;
+    case 84: // find home, seek the home position switch at speed then re-approach slowly and set position 0
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        if ( ms.moving == 0 )
+        {
+          motion_command(MOTION_FINDHOME, 0);
+        }
+      }
+      break;
+    case 85: // get homing progress, 0=idle, 1=seek, 2=back off, 3=approach, 4=done, 5=failed
+      SendPaket('r', homestate);
+      break;
+    case 86: // move queue
+      // :86#                             get progress, returns segment,count,running - segment is 1 based
+      // :86pos[,dwell[,speed]];pos...#   load and run the queue, dwell [ms] after the segment, speed 0-2
+      // the motion task loads the queue, it ignores the load if the focuser is moving
+      if ( param[0] == '\0' )
+      {
+        char buf[20];
+        snprintf(buf, sizeof(buf), "%u,%u,%u", movequeueindex, movequeuecount, movequeuerun);
+        SendPaket('q', buf);
+      }
+      else
+      {
+        motion_command(MOTION_QUEUECLEAR, 0);
+        const char *seg = param;
+        for ( int segments = 0; (segments < MOVEQUEUESIZE) && (*seg != '\0'); segments++ )
+        {
+          char *next;
+          long target = strtol(seg, &next, 10);       // a negative target or dwell is 0, the target is limited to maxstep when added
+          long dwell = 0;
+          byte mspeed = MOVESPEEDSETTING;
+          if ( *next == ',' )
+          {
+            dwell = strtol(next + 1, &next, 10);
+            if ( *next == ',' )
+            {
+              mspeed = (byte) strtol(next + 1, &next, 10);
+            }
+          }
+          target = ( target < 0 ) ? 0 : target;
+          dwell = ( dwell < 0 ) ? 0 : dwell;
+          motion_queueadd((unsigned long) target, (unsigned long) dwell, mspeed);     // segments past MOVEQUEUESIZE are ignored
+          next = strchr(next, ';');
+          seg = ( next == NULL ) ? "" : next + 1;
+        }
+        motion_command(MOTION_RUNQUEUE, 0);           // runs the queue if segments were loaded
+      }
+      break;
     case 87: // get tc direction
       SendPaket('k', mySetupData->get_tcdirection());
       break;
     case 88: // set tc direction
-      WorkString = receiveString.substring(3, receiveString.length() - 1);
-      paramval = (byte)WorkString.toInt();
+      paramval = (byte)atol(param);
       mySetupData->set_tcdirection((byte) (paramval));
       break;
     case 89:  // Get stepper power (reads from A7) - only valid if circuit is added (1=stepperpower ON)
@@ -608,10 +672,9 @@ void ESP_Communication()
       break;
     case 90: // Set preset x [0-9] with position value yyyy [unsigned long]
       {
-        byte preset = (byte) (receiveString[3] - '0');
+        byte preset = (byte) (param[0] - '0');
         preset = (preset > 9) ? 9 : preset;
-        WorkString = receiveString.substring(4, receiveString.length() - 1);
-        unsigned long tmppos = (unsigned long) WorkString.toInt();
+        unsigned long tmppos = (unsigned long) atol((param[0] != '\0') ? param + 1 : param);
         mySetupData->set_focuserpreset( preset, tmppos );
         // update cached copy
         presets[preset] = tmppos;
@@ -619,42 +682,27 @@ void ESP_Communication()
       break;
     case 91: // get focuserpreset [0-9]
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        byte preset =(byte)WorkString.toInt();
+        byte preset =(byte)atol(param);
         SendPaket('h', presets[preset]);
       }
       break;
     case 92: // Set OLED page display option
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        if ( WorkString == "" )                                     // check for null
-        {
-          WorkString = String(OLEDPGOPTIONALL, BIN);
-        }
-        if ( WorkString.length() != 3  )                            // check for 3 digits
-        {
-          WorkString = String(OLEDPGOPTIONALL, BIN);
-        }
-        for ( unsigned int i = 0; i < WorkString.length(); i++)     // check for 0 or 1
-        {
-          if ( (WorkString[i] != '0') && (WorkString[i] != '1') )
-          {
-            WorkString = String(OLEDPGOPTIONALL, BIN);
-            break;
-          }
-        }
         Comms_DebugPrint("Set: Display Page Option: ");
-        Comms_DebugPrintln(WorkString);
-        // Convert binary string tp to integer
+        Comms_DebugPrintln(param);
+        // Convert binary string tp to integer, null, not 3 digits or not 0 or 1 sets all pages
         int value = 0;
-        for (unsigned int i = 0; i < WorkString.length(); i++) // for every character in the string  strlen(s) returns the length of a char array
+        bool valid = ( strlen(param) == 3 );                        // check for null and 3 digits
+        for ( unsigned int i = 0; valid && (i < 3); i++)            // for every character in the string
         {
+          valid = (param[i] == '0') || (param[i] == '1');           // check for 0 or 1
           value *= 2; // double the result so far
-          if (WorkString[i] == '1')
+          if (param[i] == '1')
           {
             value++;  // add 1 if needed
           }
         }
+        value = ( valid == true ) ? value : OLEDPGOPTIONALL;
         Comms_DebugPrint("Display Page Option (byte): ");
         Comms_DebugPrintln(value);
         mySetupData->set_oledpageoption((byte) value);
@@ -664,19 +712,18 @@ void ESP_Communication()
       {
         // return as string of 01's
         char buff[10];
-        memset(buff, 0, 10);
-        String answer = String( mySetupData->get_oledpageoption(), BIN );
-        // assign leading 0's if necessary
-        while ( answer.length() < 3)
+        byte option = mySetupData->get_oledpageoption();
+        // at least 3 digits, with leading 0's if necessary
+        unsigned int digits = 3;
+        while ( (digits < 8) && ((option >> digits) != 0) )
         {
-          answer = "0" + answer;
+          digits++;
         }
-        unsigned int i;
-        for ( i = 0; i < answer.length(); i++ )
+        for ( unsigned int i = 0; i < digits; i++ )
         {
-          buff[i] = answer[i];
+          buff[i] = ( (option >> (digits - 1 - i)) & 1 ) ? '1' : '0';
         }
-        buff[i] = 0;
+        buff[digits] = 0;
         Comms_DebugPrint("Get: oled page option: ");
         Comms_DebugPrintln(buff);
         SendPaket('l', buff );
@@ -684,8 +731,8 @@ void ESP_Communication()
       break;
     case 96: // Set management options
       {
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        int option = WorkString.toInt();
+        int option = atol(param);
+        const char *drvbrd = mySetupData->get_brdname().c_str();
         if ( (option & 1) == 1 )
         {
           // ascom server start if not already started
@@ -713,7 +760,7 @@ void ESP_Communication()
           {
             mySetupData->set_inoutledstate(1);
             // reinitialise pins
-            if (drvbrd.equals("PRO2ESP32ULN2003") || drvbrd.equals("PRO2ESP32L298N") || drvbrd.equals("PRO2ESP32L293DMIN") || drvbrd.equals("PRO2ESP32L9110S") || drvbrd.equals("PRO2ESP32DRV8825") )
+            if ( !strcmp(drvbrd, "PRO2ESP32ULN2003") || !strcmp(drvbrd, "PRO2ESP32L298N") || !strcmp(drvbrd, "PRO2ESP32L293DMIN") || !strcmp(drvbrd, "PRO2ESP32L9110S") || !strcmp(drvbrd, "PRO2ESP32DRV8825") )
             {
               init_leds();
             }
@@ -829,8 +876,7 @@ void ESP_Communication()
     case 99:  // set homepositonswitch state, 0 or 1
       {
         int enablestate = 0;
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        enablestate = WorkString.toInt();
+        enablestate = atol(param);
         if ( mySetupData->get_brdhpswpin() == -1)
         {
           Comms_DebugPrintln("hpswpin is -1");
@@ -841,19 +887,12 @@ void ESP_Communication()
           if ( enablestate == 1 )
           {
             Comms_DebugPrintln("hpsw state: enabled");
-            if ( driverboard->init_hpsw() == true)
-            {
-              Comms_DebugPrintln("hpsw init OK");
-            }
-            else
-            {
-              Comms_DebugPrintln("hpsw init NOK");
-            }
           }
           else
           {
             Comms_DebugPrintln("hpsw state: disabled");
           }
+          motion_command(MOTION_INITHPSW, 0);           // the switch interrupt follows the setting
         }
       }
       break;
@@ -865,8 +904,7 @@ void ESP_Communication()
     case 59:    // set coilpower timeout value (in milliseconds)
       {
         unsigned long cptime = 0;
-        WorkString = receiveString.substring(3, receiveString.length() - 1);
-        cptime = WorkString.toInt();
+        cptime = atol(param);
         mySetupData->set_coilpower_timeout(cptime);
         Comms_DebugPrint("cp timeout=");
         Comms_DebugPrintln(cptime);
@@ -882,16 +920,22 @@ void ESP_Communication()
     case 41:
       break;
     case 44: // myFP2 set motorspeed threshold when moving - switches to slowspeed when nearing destination
-      //ignore
+      {
+        long tmp = atol(param);
+        tmp = ( tmp < 0 ) ? 0 : tmp;
+        tmp = ( tmp > MAXMSTHRESHOLD ) ? MAXMSTHRESHOLD : tmp;
+        mySetupData->set_motorspeedthreshold((unsigned long) tmp);
+      }
       break;
     case 45: // myFP2 get motorspeedchange threshold value
-      SendPaket('G', "200");
+      SendPaket('G', mySetupData->get_motorspeedthreshold());
       break;
     case 46: // myFP2 enable/Disable motorspeed change when moving
-      //ignore
+      paramval = (byte) atol(param) & 1;
+      mySetupData->set_motorspeedchange((byte) paramval);
       break;
     case 47: // get motorspeedchange enabled? on/off
-      SendPaket('J', "0");
+      SendPaket('J', mySetupData->get_motorspeedchange());
       break;
     case 57: // myFP2 set Super Slow Jogging Speed
       // ignore
@@ -933,13 +977,15 @@ void send_boardconfig_file(void)
   else
   {
     delay(10);
-    // Reading board_config.jsn
-    board_data = bfile.readString();                                // read content of the text file
+    // Reading board_config.jsn into a fixed buffer, a longer file is cut, the reply is the file and EOFSTR
+    char board_data[320];
+    size_t len = bfile.readBytes(board_data, sizeof(board_data) - 2);
+    bfile.close();
+    board_data[len++] = EOFSTR;
+    board_data[len] = '\0';
     Comms_DebugPrint("LoadConfiguration(): Board_data= ");
     Comms_DebugPrintln(board_data);                             // ... and print on serial
-    bfile.close();
-    board_data = board_data + EOFSTR;
-    SendPaket('W', "null", true );
+    SendMessage(board_data);
   }
 }
 #endif // #if defined(CONTROLLERMODE)
@@ -964,17 +1010,23 @@ void processserial()
     switch ( inChar )
     {
       case STARTCMDSTR :     // start
-        serialline = "";
+        queue.start();
         break;
       case '\r' :
       case '\n' :
         // ignore
         break;
       case EOFSTR :       // eoc
-        queue.push(serialline);
+        if ( queue.push() == false )
+        {
+          Comms_DebugPrint("command dropped, queue full: ");
+          Comms_DebugPrint(queue.overflows());
+          Comms_DebugPrint(", too long: ");
+          Comms_DebugPrintln(queue.toolong());
+        }
         break;
       default :           // anything else
-        serialline = serialline + inChar;
+        queue.put(inChar);
         break;
     }
   }
@@ -1001,17 +1053,23 @@ void processbt()
     switch ( inChar )
     {
       case STARTCMDSTR :     // start
-        btline = "";
+        queue.start();
         break;
       case '\r' :
       case '\n' :
         // ignore
         break;
       case EOFSTR :       // eoc
-        queue.push(btline);
+        if ( queue.push() == false )
+        {
+          Comms_DebugPrint("command dropped, queue full: ");
+          Comms_DebugPrint(queue.overflows());
+          Comms_DebugPrint(", too long: ");
+          Comms_DebugPrintln(queue.toolong());
+        }
         break;
       default :           // anything else
-        btline = btline + inChar;
+        queue.put(inChar);
         break;
     }
   }
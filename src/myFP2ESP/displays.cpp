@@ -218,11 +218,13 @@ void OLED_GRAPHIC::oled_draw_main_update()
   myoled->setTextAlignment(TEXT_ALIGN_CENTER);
   myoled->setFont(ArialMT_Plain_24);
 
+  MotionState ms;
+  driverboard->getmotionstate(ms);
   char dir = (mySetupData->get_focuserdirection() == moving_in ) ? '<' : '>';
   if (mySetupData->get_brdstepmode() != 1) {
-    snprintf(buffer, sizeof(buffer), "%lu:%i %c", driverboard->getposition(), (int)(driverboard->getposition() % mySetupData->get_brdstepmode()), dir);
+    snprintf(buffer, sizeof(buffer), "%lu:%i %c", ms.position, (int)(ms.position % mySetupData->get_brdstepmode()), dir);
   } else {
-    snprintf(buffer, sizeof(buffer), "%lu %c", driverboard->getposition(), dir);
+    snprintf(buffer, sizeof(buffer), "%lu %c", ms.position, dir);
   }
   myoled->drawString(64, 28, buffer);
 
@@ -413,9 +415,9 @@ void OLED_GRAPHIC::pbControl(unsigned long &ftargetPosition, pbTimer &pbModTimer
       } else if (curSetting == 4) {
         adjustValue(pbUpTimer, pbDnTimer, newCurPosOffset, 0-ftargetPosition, 999999 - ftargetPosition);
       } else if (curSetting == 7) {
-        adjustValue(pbUpTimer, pbDnTimer, newBlInOffset, 0 - mySetupData->get_backlashsteps_in(), 999999 - mySetupData->get_backlashsteps_in());
+        adjustValue(pbUpTimer, pbDnTimer, newBlInOffset, 0 - mySetupData->get_backlashsteps_in(), MAXBACKLASHSTEPS - mySetupData->get_backlashsteps_in());
       } else if (curSetting == 8) {
-        adjustValue(pbUpTimer, pbDnTimer, newBlOutOffset, 0 - mySetupData->get_backlashsteps_out(), 999999 - mySetupData->get_backlashsteps_out());
+        adjustValue(pbUpTimer, pbDnTimer, newBlOutOffset, 0 - mySetupData->get_backlashsteps_out(), MAXBACKLASHSTEPS - mySetupData->get_backlashsteps_out());
       } else if (pbUpTimer.current && !pbUpTimer.last) {
         if (curSetting == 0) mySetupData->set_hpswitchenable(mySetupData->get_hpswitchenable() ? (byte) 0 : (byte) 1);
         else if (curSetting == 1) mySetupData->set_temperatureprobestate(mySetupData->get_temperatureprobestate() ? (byte) 0 : (byte) 1);
@@ -861,14 +863,16 @@ void OLED_TEXT::update_oledtextdisplay(void)
 
 void OLED_TEXT::update_oledtext_position(void)
 {
+  MotionState ms;
+  driverboard->getmotionstate(ms);
   myoled->setCursor(0, 0);
   myoled->print(CURRENTPOSSTR);
-  myoled->print(driverboard->getposition());
+  myoled->print(ms.position);
   myoled->clearToEOL();
   myoled->println();
 
   myoled->print(TARGETPOSSTR);
-  myoled->print(ftargetPosition);
+  myoled->print(ms.target);
   myoled->clearToEOL();
   myoled->println();
   //  display();
@@ -877,15 +881,17 @@ void OLED_TEXT::update_oledtext_position(void)
 void OLED_TEXT::display_oledtext_page0(void)           // display screen
 {
   char tempString[20];
+  MotionState ms;
+  driverboard->getmotionstate(ms);
 
   myoled->home();
   myoled->print(CURRENTPOSSTR);
-  myoled->print(driverboard->getposition());
+  myoled->print(ms.position);
   myoled->clearToEOL();
 
   myoled->println();
   myoled->print(TARGETPOSSTR);
-  myoled->print(ftargetPosition);
+  myoled->print(ms.target);
   myoled->clearToEOL();
   myoled->println();
 
@@ -111,6 +111,15 @@
 // To enable the Infrared remote controller [ESP32 only], uncomment the next line
 //#define INFRAREDREMOTE
 
+// To generate step pulses with the RMT peripheral instead of the timer ISR
+// [ESP32 step/dir boards only], uncomment the next line
+// Ramped moves, homing moves and slow moves still use the timer ISR
+//#define HWSTEPGEN 	1
+
+// To run the motion state machine and the communications in their own tasks,
+// one on each core [ESP32 only], uncomment the next line
+#define MOTIONTASK 	1
+
 // ======================================================================
 // 6: CONTROLLER MODE
 // ======================================================================
@@ -144,6 +153,10 @@
 // Management Server Control Interface [Port 6060] - DO NOT CHANGE
 #define MANAGEMENT 	9
 
+// Number of tcp clients served at the same time on the myFP2ESP tcp/ip port
+// [ACCESSPOINT and STATIONMODE], further connections are refused
+#define TCPCLIENTS 	4
+
 // Cannot use DuckDNS with ACCESSPOINT, BLUETOOTHMODE or LOCALSERIAL mode
 // To enable DUCKDNS [STATIONMODE only]
 //#define USEDUCKDNS 	1
@@ -220,6 +233,19 @@
 #endif
 #endif
 
+#ifdef HWSTEPGEN
+#if !(DRVBRD == PRO2ESP32DRV8825 || DRVBRD == PRO2ESP32R3WEMOS || DRVBRD == PRO2ESP32TMC2225 \
+  || DRVBRD == PRO2ESP32TMC2209  || DRVBRD == PRO2ESP32TMC2209P )
+#error // err: HWSTEPGEN needs an ESP32 board with a step/dir driver
+#endif
+#endif // #ifdef HWSTEPGEN
+
+#if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
+#if !defined(TCPCLIENTS) || (TCPCLIENTS < 1)
+#error // err: TCPCLIENTS must be 1 or more
+#endif
+#endif
+
 #ifndef PROTOCOL
 #error // err: Protocol has not been defined, must be MYFP2ESP_PROTOCOL or MOONLITE_PROTOCOL
 #endif // #ifndef PROTOCOL
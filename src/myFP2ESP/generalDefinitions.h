@@ -20,8 +20,39 @@ struct pbTimer {
 // ======================================================================
 
 enum connection_status { disconnected, connected };
+// move queue segment, executed back to back by the main state machine
+struct MoveSegment
+{
+  unsigned long target;                     // target position
+  unsigned long dwell;                      // wait after the segment [ms]
+  byte          speed;                      // motorspeed 0-2, MOVESPEEDSETTING = use setting
+};
+// command to the motion state machine, from comms, web, ascom and management servers
+struct MotionCommand
+{
+  byte          cmd;                        // MOTION_MOVE .. MOTION_QUEUEADD
+  long          value;                      // target, position, relative steps or setting
+  MoveSegment   seg;                        // MOTION_QUEUEADD, the segment
+};
+// move statistics since the controller started
+struct MoveStats
+{
+  uint32_t      moves;                      // moves started, the restart after an overshoot or retarget is the same move
+  uint32_t      steps;                      // steps that changed the position, overshoot not included
+  uint32_t      backlash;                   // backlash steps, position not changed
+  uint32_t      overshoot;                  // extra steps of final approach, past the target and back
+};
+// cpu load of a task, busy time over a TASKLOADPERIOD window
+struct TaskLoad
+{
+  uint32_t      busy;                       // busy time in this window [uS]
+  uint32_t      start;                      // start of this window [ms]
+  byte          load;                       // busy percentage of the last window
+};
 //  StateMachine definition
-enum StateMachineStates { State_Idle, State_InitMove, State_Backlash, State_Moving, State_DelayAfterMove, State_FinishedMove, State_SetHomePosition };
+enum StateMachineStates { State_Idle, State_InitMove, State_Moving, State_DelayAfterMove, State_FinishedMove, State_SetHomePosition,
+                          State_FindHome, State_HomeSeek, State_HomeBackOff, State_HomeClear, State_HomeApproach, State_QueueDwell,
+                          State_BlCalStart, State_BlCalSeek, State_BlCalOut, State_BlCalIn };
 
 // controller modes
 #define BLUETOOTHMODE         1
@@ -36,10 +67,13 @@ enum StateMachineStates { State_Idle, State_InitMove, State_Backlash, State_Movi
 // INTERFACE SETTINGS
 #define EOFSTR                '#'
 #define STARTCMDSTR           ':'
+#define CMDBUFSIZE            320           // longest command with its start character, :86 move queue of 16 segments
+#define TCPOUTBUFSIZE         512           // replies to a tcp client collected in a loop pass, sent with one write
+#define TCPCMDSPERPASS        8             // commands of one tcp client processed in a loop pass
 #define ESPDATA               0             // command has come from tcp/ip
 #define BTDATA                1             // command has come from bluetooth
 #define SERIALDATA            2             // command has come from serial port
-#define QUEUELENGTH           20            // number of commands that can be saved in the serial queue
+#define QUEUELENGTH           8             // number of commands that can be saved in the serial queue, CMDBUFSIZE each
 #define RUNNING               true          // service state running
 #define STOPPED               false         // service state stopped
 #define REBOOTDELAY           2000          // When rebooting controller, delay (2s) from msg to actual reboot
@@ -58,8 +92,100 @@ enum StateMachineStates { State_Idle, State_InitMove, State_Backlash, State_Movi
 #define FOCUSERUPPERLIMIT     2000000000L   // arbitary focuser limit up to 2000000000
 #define FOCUSERLOWERLIMIT     1024L         // lowest value that maxsteps can be
 #define HOMESTEPS             200           // Prevent searching for home position switch never returning, this should be > than # of steps between closed and open
+#define MAXHOMESTEPS          100000L       // upper limit for homesteps setting
+#define MSTHRESHOLD           200           // motorspeed change, steps before the target where the move slows down
+#define MAXMSTHRESHOLD        100000L       // upper limit for motorspeed change threshold
+#define PHASE_NONE            0             // move runs in the step mode setting
+#define PHASE_COARSE          1             // slew in the coarse step mode, fine phase follows
+#define DEFAULTCOARSESTEPMODE 0             // coarse step mode of TMC boards, 0 = no coarse slew
+#define FINESTEPS             400           // fine steps at the end of a move with a coarse slew
+#define MAXFINESTEPS          100000L       // upper limit for finesteps setting
+#define TMCREG_MRES           0             // tmc shadow registers, microsteps
+#define TMCREG_CURRENT        1             // rms current mA
+#define TMCREG_SGTHRS         2             // stall guard threshold, tmc2209
+#define TMCREG_TPWMTHRS       3             // StealthChop to SpreadCycle threshold, TSTEP
+#define TMCREG_TCOOLTHRS      4             // CoolStep and StallGuard threshold, TSTEP, tmc2209
+#define TMCREG_SEMIN          5             // CoolStep lower threshold, 0 = CoolStep off, tmc2209
+#define TMCREGS               6
+#define TMCFCLK               12000000L     // TMC internal clock, TSTEP is in 1/TMCFCLK per 1/256 microstep
+#define TMCTSTEPMAX           0xFFFFFL      // 20 bit TSTEP thresholds
+#define DEFAULTSPREADVELOCITY 0             // SpreadCycle above this velocity, 0 = always StealthChop
+#define COOLSTEPSEMIN         5             // CoolStep current down when SG_RESULT > semin * 32
+#define TMCSTEALTH(s)         (((s) >> 30) & 1)       // DRV_STATUS, driver is in StealthChop
+#define TMCCSACTUAL(s)        (((s) >> 16) & 0x1f)    // DRV_STATUS, actual current scale 0-31
+#define COOLSTEPSEMAX         2             // CoolStep current up when SG_RESULT < (semin + semax + 1) * 32
+#define TMCPOLLINTERVAL       500           // read back a TMC status register every 500ms
+#define MAXBACKLASHSTEPS      65535L        // upper limit for backlash steps in and out
+#define APPROACH_OFF          0             // approachdir, moves end in either direction, backlash steps are applied
+#define APPROACH_IN           1             // every move ends moving in, moves out overshoot and come back
+#define APPROACH_OUT          2             // every move ends moving out, moves in overshoot and come back
+#define DEFAULTOVERSHOOT      100           // steps past the target of moves against the approach direction
+#define MAXOVERSHOOT          100000L       // upper limit for overshoot setting
+#define HOMECLEARSTEPS        50            // find home, steps to move clear of the switch before the slow re-approach
 #define HPSWOPEN              0             // hpsw states refelect status of switch
 #define HPSWCLOSED            1
+#define HPSW_STOPCLOSED       0             // step ISR stops a move in when the home position switch closes
+#define HPSW_STOPOPEN         1             // step ISR stops a move when the home position switch opens, homing back off
+#define HOME_IDLE             0             // homestate, progress of homing
+#define HOME_SEEK             1             // moving in to find the switch
+#define HOME_BACKOFF          2             // moving out till the switch opens
+#define HOME_APPROACH         3             // slow re-approach of the switch
+#define HOME_DONE             4             // position set to 0
+#define HOME_FAILED           5             // switch not found, stuck closed or halted
+#define BLCALREPEATS          5             // backlash calibration, measurements in each direction, the median is stored
+#define BLCAL_IDLE            0             // blcalstate, progress of backlash calibration
+#define BLCAL_SEEK            1             // moving in to find the switch
+#define BLCAL_OUT             2             // moving out till the switch opens, measures backlash out
+#define BLCAL_IN              3             // moving in till the switch closes, measures backlash in
+#define BLCAL_DONE            4             // backlash steps stored, focuser homed
+#define BLCAL_FAILED          5             // no switch, stall guard, switch not found, stuck closed or halted
+#define DEFAULTMOTORACCEL     0             // step acceleration in steps/s/s, 0 = no ramp, steps at a constant rate
+#define DEFAULTMOTORMAXSPEED  0             // cruise speed in steps/s, 0 = use board msdelay
+#define MAXMOTORACCEL         100000L       // upper limit for motor acceleration steps/s/s
+#define MAXMOTORMAXSPEED      50000L        // upper limit for motor cruise speed steps/s
+#define RAMPMAXINTERVAL       1000000L      // longest step interval [uS] at the start of a ramp
+#define PROFILE_TRAPEZOID     0             // motor profile, constant acceleration
+#define PROFILE_SCURVE        1             // motor profile, jerk limited acceleration
+#define DEFAULTMOTORVELOCITY  0             // fast motorspeed, 0 = use board msdelay
+#define MAXMOTORVELOCITY      50000L        // upper limit for motor velocity
+#define VELOCITY_FULLSTEPS    0             // motorvelocity unit, full steps/s
+#define VELOCITY_MICRONS      1             // motorvelocity unit, um/s, uses stepsize
+#if defined(ESP8266)
+#define VELOCITYMININTERVAL   50            // shortest step interval [uS] the timer ISR keeps up with
+#else
+#define VELOCITYMININTERVAL   10
+#endif
+#define MOVESPEEDSETTING      255           // move uses the motorspeed setting
+#define MOVEQUEUESIZE         16            // max segments in the move queue
+#define MOVEQUEUEDOCSIZE      1536          // json document size for a full move queue, management server
+#define MOTION_MOVE           0             // motion command, move to value
+#define MOTION_MOVEBY         1             // move value steps relative to the target
+#define MOTION_HALT           2             // halt the running move
+#define MOTION_SETPOSITION    3             // set position and target to value, no move
+#define MOTION_FINDHOME       4             // find the home position switch
+#define MOTION_RUNQUEUE       5             // run the loaded move queue
+#define MOTION_DISPLAYOFF     6             // turn the display off, the display is driven by the motion task
+#define MOTION_BLCALIBRATE    7             // measure backlash in and out on the home position switch
+#define MOTION_DISPLAYON      8             // turn the display on
+#define MOTION_STEPMODE       9             // set the step mode to value, pins or TMC driver
+#define MOTION_COILPOWER      10            // value 1 enables the motor, 0 releases it
+#define MOTION_INITHPSW       11            // setup the home position switch after it was enabled or disabled
+#define MOTION_STALLGUARD     12            // set the TMC2209 stall guard value
+#define MOTION_TMC2209CURRENT 13            // set the TMC2209 current [mA]
+#define MOTION_TMC2225CURRENT 14            // set the TMC2225 current [mA]
+#define MOTION_QUEUECLEAR     15            // start loading the move queue, ignored while moving
+#define MOTION_QUEUEADD       16            // add seg to the move queue being loaded
+#define MOTIONQUEUESIZE       (MOVEQUEUESIZE + 4) // motion commands waiting for the motion task, a full move queue load fits
+#define MOTIONTASKCORE        1             // motion task, state machine and step control
+#define COMMSTASKCORE         0             // comms task, tcp, serial, web, ascom and management servers
+#define MOTIONTASKSTACK       8192
+#define COMMSTASKSTACK        8192
+#define TASKLOADPERIOD        1000          // window for the task cpu load [ms]
+#define STEPGEN_PULSE         2             // step pulse high time [uS], hardware step generator
+#define STEPGEN_MININTERVAL   4             // shortest step interval [uS] of the hardware step generator
+#define STEPGEN_MAXINTERVAL   1000          // longest step interval [uS], slower moves use the timer ISR
+#define STEPGEN_PCNTLIMIT     10000         // pulse counter wraps at this count
+#define STEPGEN_STOPTIMEOUT   100           // wait for the pulses in flight when a move is stopped [mS]
 
 // ASCOM SERVICE
 #define ALPACAPORT            4040          // ASCOM Remote port
@@ -416,6 +542,11 @@ extern const char* WRITEFILESUCCESSSTR;
 #define TIMEASCOMHANDLEAPIVER       1
 #define TIMEASCOMHANDLEAPIDES       1
 #define TIMEASCOMHANDLEAPICON       1
+
+//#define TIMEMOVEMOTOR               1           // cpu cycles per step of the timer ISR step path
+//#define MOVEMOTORRUNTIME            1           // use board number chain instead of driver policy, to compare
+//#define STEPTRACE                   1           // record each step of the timer ISR, download from management server /steptrace
+#define STEPTRACESIZE               1024        // entries in the step trace ring, must be a power of 2
 #endif
 
 #endif // generalDefinitions.h
@@ -32,7 +32,6 @@ extern volatile bool halt_alert;
 extern portMUX_TYPE  halt_alertMux;
 #endif
 
-extern byte          isMoving;
 extern int           tprobe1;
 extern float         lasttemp;
 extern const char*   programVersion;
@@ -42,6 +41,7 @@ extern DriverBoard   *driverboard;
 extern TempProbe     *myTempProbe;
 
 extern void software_Reboot(int);
+extern void motion_command(byte, long);
 
 // ======================================================================
 // LOCAL DATA [for moonlite code]
@@ -95,7 +95,8 @@ void SendMessage(const char *str)
   Comms_DebugPrint("Send: ");
   Comms_DebugPrintln(str);
 #if ( (CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE) )  // for Accesspoint or Station mode
-  myclient.print(str);
+  tcpclient->send(str);                               // sent by comms_loop() at the end of the pass
+  tcpclient->packetssent++;
   packetssent++;
 #elif (CONTROLLERMODE == BLUETOOTHMODE)             // for bluetooth
   SerialBT.print(str);
@@ -123,10 +124,16 @@ void ESP_Communication()
   static boolean newtargetpositionset = false;      // used in moonlite to to indicate if a new target has been set
   static float   mtempoffsetval = 0.0;              // used in moonlite to set a temperature correction value
 
-#if (CONTROLLERMODE == BLUETOOTHMODE)
-  receiveString = STARTCMDSTR + queue.pop();
-#elif (CONTROLLERMODE == LOCALSERIAL)
-  receiveString = STARTCMDSTR + queue.pop();
+#if (CONTROLLERMODE == BLUETOOTHMODE) || (CONTROLLERMODE == LOCALSERIAL)
+  {
+    char line[CMDBUFSIZE];
+    queue.pop(line, sizeof(line));
+    receiveString = String(STARTCMDSTR) + line;
+  }
+#else   // for Accesspoint or Station mode, comms_loop() has assembled the command of tcpclient
+  tcpclient->packetsreceived++;
+  packetsreceived++;
+  receiveString = tcpclient->cmd.line;
 #endif
 
   Comms_DebugPrint("raw receive string=");
@@ -160,8 +167,12 @@ void ESP_Communication()
   {
     // GP get the current focuser position
     case 20551:
-      sprintf(tempCharArray, "%04X", (unsigned int) driverboard->getposition());
-      SendPacket(tempCharArray);
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        sprintf(tempCharArray, "%04X", (unsigned int) ms.position);
+        SendPacket(tempCharArray);
+      }
       break;
 
     // GN get the new motor position (target)
@@ -215,13 +226,17 @@ void ESP_Communication()
 
     // GI "01" if the motor is moving, otherwise "00"
     case 18759:
-      if ( isMoving == 1 )
       {
-        SendPacket("01");
-      }
-      else
-      {
-        SendPacket("00");
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        if ( ms.moving == 1 )
+        {
+          SendPacket("01");
+        }
+        else
+        {
+          SendPacket("00");
+        }
       }
       break;
 
@@ -242,9 +257,8 @@ void ESP_Communication()
       {
         paramval = (paramval < 0) ? 0 : paramval;               // we cannot have a negative position
         unsigned long tmppos = ((unsigned long) paramval > mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : (unsigned long) paramval;
-        ftargetPosition = tmppos;
-        driverboard->setposition(tmppos);
-        mySetupData->set_fposition(tmppos);
+        motion_command(MOTION_SETPOSITION, tmppos);
+        mySetupData->set_fposition(tmppos);                     // saved now, not when the motion task applies it
         mySetupData->SaveNow();
       }
       break;
@@ -263,17 +277,17 @@ void ESP_Communication()
 
     // Basic rule for setting stepmode in this order
     // 1. Set mySetupData->set_brdstepmode(xx);               // this saves config setting
-    // 2. Set driverboard->setstepmode(xx);                   // this sets the physical pins
+    // 2. Send motion_command(MOTION_STEPMODE, xx);           // the motion task sets the physical pins
     // SF set Motor 1 to Full Step
     case 18003:
       mySetupData->set_brdstepmode(STEP1);
-      driverboard->setstepmode(STEP1);
+      motion_command(MOTION_STEPMODE, STEP1);
       break;
 
     // SH set Motor 1 to Half Step
     case 18515:
       mySetupData->set_brdstepmode(STEP2);
-      driverboard->setstepmode(STEP2);
+      motion_command(MOTION_STEPMODE, STEP2);
       break;
 
     // SD set the Motor 1 speed, valid options are "02, 04, 08, 10, 20"
@@ -301,7 +315,7 @@ void ESP_Communication()
     case 18246:
       if ( newtargetpositionset == true)
       {
-        ftargetPosition = newtargetPosition;
+        motion_command(MOTION_MOVE, newtargetPosition);
         newtargetpositionset = false;
       }
       else
@@ -313,9 +327,7 @@ void ESP_Communication()
 
     // FQ Halt Motor 1 move, position is retained, motor is stopped.
     case 20806:
-      varENTER_CRITICAL(&halt_alertMux);
-      halt_alert = true;
-      varEXIT_CRITICAL(&halt_alertMux);
+      motion_command(MOTION_HALT, 0);
       Comms_DebugPrintln("FQ: halt_alert = true");
       break;
 
@@ -410,7 +422,7 @@ void ESP_Communication()
     // PH Find home for Motor, valid options are "01", "02"
     case 18512:
       // not implemented in INDI driver
-      ftargetPosition = 0;
+      motion_command(MOTION_MOVE, 0);
       break;
 
     // C Initiate a temperature conversion
@@ -479,7 +491,7 @@ void ESP_Communication()
           mySetupData->set_displayenabled(0);
           if ( displayfound == true )
           {
-            myoled->display_off();
+            motion_command(MOTION_DISPLAYOFF, 0);
           }
         }
         else
@@ -487,7 +499,7 @@ void ESP_Communication()
           mySetupData->set_displayenabled(1);
           if ( displayfound == true )
           {
-            myoled->display_on();
+            motion_command(MOTION_DISPLAYON, 0);
           }
         }
       }
@@ -578,35 +590,45 @@ void ESP_Communication()
     // MT set the MotorSpeed Threshold
     case 21581:
       // myfocuser command
-      Comms_DebugPrintln(":MT# not implemented");
-      // ignore, motorspeedchange not implemented
+      Comms_DebugPrint("Set MotorSpeed Threshold : ");
+      paramval = (paramval < 0) ? 0 : paramval;
+      paramval = (paramval > MAXMSTHRESHOLD) ? MAXMSTHRESHOLD : paramval;
+      Comms_DebugPrintln(paramval);
+      mySetupData->set_motorspeedthreshold((unsigned long) paramval);
       break;
 
     // MU get the MotorSpeed Threshold
     case 21837:
-      Comms_DebugPrintln(":MU# not implemented");
-      //sprintf(tempCharArray, "%02d", THRESHOLD);
-      SendPacket("00");
+      Comms_DebugPrint("get MotorSpeed Threshold : ");
+      Comms_DebugPrintln(mySetupData->get_motorspeedthreshold());
+      sprintf(tempCharArray, "%02X", (unsigned int) mySetupData->get_motorspeedthreshold());
+      SendPacket(tempCharArray);
       break;
 
     // MV Set Enable/Disable motorspeed change when moving
     case 22093:
-      Comms_DebugPrintln(":MV# not implemented");
-      // ignore, motorspeedchange not implemented
+      Comms_DebugPrint("Set motorspeed change : ");
+      Comms_DebugPrintln((byte)(paramval & 0x01));
+      mySetupData->set_motorspeedchange((byte)(paramval & 0x01));
       break;
 
     // MW get if motorspeedchange enabled/disabled
     case 22349:
-      Comms_DebugPrintln(":MW# not implemented");
-      //sprintf(tempCharArray, "%02d", (int) motorspeedchange);
-      SendPacket("00");
+      Comms_DebugPrint("get motorspeed change : ");
+      Comms_DebugPrintln(mySetupData->get_motorspeedchange());
+      sprintf(tempCharArray, "%02X", (int) mySetupData->get_motorspeedchange());
+      SendPacket(tempCharArray);
       break;
 
     // MX Save settings to File System
     case 22605:
       // copy current settings and write the data to file
-      mySetupData->set_fposition(driverboard->getposition());       // need to save setting
-      mySetupData->SaveNow();
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        mySetupData->set_fposition(ms.position);                    // need to save setting
+        mySetupData->SaveNow();
+      }
       break;
 
     // PG get temperature precision (9-12)
@@ -711,12 +733,12 @@ void ESP_Communication()
     // SS set stepmode
     // Basic rule for setting stepmode in this order
     // 1. Set mySetupData->set_brdstepmode(xx);       // this saves config setting
-    // 2. Set driverboard->setstepmode(xx);           // this sets the physical pins
+    // 2. Send motion_command(MOTION_STEPMODE, xx);   // the motion task sets the physical pins
     case 21331:
       Comms_DebugPrint("Set Step Mode : ");
       Comms_DebugPrintln((int)paramval);
       mySetupData->set_brdstepmode((int)(paramval));
-      driverboard->setstepmode((int)(paramval));
+      motion_command(MOTION_STEPMODE, (int)(paramval));
       break;
 
     // SM set new maxSteps position SMXXXX
@@ -728,7 +750,11 @@ void ESP_Communication()
       // check if below lowest set value for maxstep
       paramval = (paramval < FOCUSERLOWERLIMIT) ? FOCUSERLOWERLIMIT : paramval;
       // check to make sure its not less than current focuser position
-      paramval = (paramval < driverboard->getposition()) ? driverboard->getposition() : paramval;
+      {
+        MotionState ms;
+        driverboard->getmotionstate(ms);
+        paramval = (paramval < (long) ms.position) ? (long) ms.position : paramval;
+      }
       // for NEMA17 at 400 steps this would be 5 full rotations of focuser knob
       // for 28BYG-28 this would be less than 1/2 a revolution of focuser knob
       mySetupData->set_maxstep(paramval);
@@ -787,17 +813,23 @@ void processserial()
     switch ( inChar )
     {
       case STARTCMDSTR :     // start
-        serialline = "";
+        queue.start();
         break;
       case '\r' :
       case '\n' :
         // ignore
         break;
       case EOFSTR :       // eoc
-        queue.push(serialline);
+        if ( queue.push() == false )
+        {
+          Comms_DebugPrint("command dropped, queue full: ");
+          Comms_DebugPrint(queue.overflows());
+          Comms_DebugPrint(", too long: ");
+          Comms_DebugPrintln(queue.toolong());
+        }
         break;
       default :           // anything else
-        serialline = serialline + inChar;
+        queue.put(inChar);
         break;
     }
   }
@@ -823,17 +855,23 @@ void processbt()
     switch ( inChar )
     {
       case STARTCMDSTR :     // start
-        btline = "";
+        queue.start();
         break;
       case '\r' :
       case '\n' :
         // ignore
         break;
       case EOFSTR :       // eoc
-        queue.push(btline);
+        if ( queue.push() == false )
+        {
+          Comms_DebugPrint("command dropped, queue full: ");
+          Comms_DebugPrint(queue.overflows());
+          Comms_DebugPrint(", too long: ");
+          Comms_DebugPrintln(queue.toolong());
+        }
         break;
       default :           // anything else
-        btline = btline + inChar;
+        queue.put(inChar);
         break;
     }
   }
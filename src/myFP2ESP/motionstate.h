@@ -0,0 +1,84 @@
+// ======================================================================
+// motionstate.h : myFP2ESP MOTION STATE SNAPSHOT
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+#ifndef motionstate_h
+#define motionstate_h
+
+#include <Arduino.h>
+
+// ======================================================================
+// MOTION STATE : one consistent snapshot of the motion for all readers
+// ======================================================================
+struct MotionState
+{
+  unsigned long position;                         // focuser position
+  unsigned long target;                           // target position
+  uint32_t      stepcount;                        // steps left in the running move
+  bool          stepdir;                          // direction of the running move
+  byte          moving;                           // isMoving
+};
+
+// ======================================================================
+// MOTION SEQLOCK : sequence lock around the published motion state
+// ======================================================================
+// seq is odd while the fields are written. Readers copy the fields without locking and retry if seq was
+// odd or has changed. Writers are not locked here, the caller serializes them, see myBoards.cpp
+class MotionSeqlock
+{
+  public:
+    // publish position, steps and direction, used by the timer ISR
+    inline void update(unsigned long position, uint32_t stepcount, bool stepdir) __attribute__((always_inline))
+    {
+      seq++;                                      // odd, update in progress
+      __sync_synchronize();
+      ms_position  = position;
+      ms_stepcount = stepcount;
+      ms_stepdir   = stepdir;
+      __sync_synchronize();
+      seq++;                                      // even, update done
+    }
+
+    // publish all fields
+    void set(const MotionState &ms)
+    {
+      seq++;
+      __sync_synchronize();
+      ms_position  = ms.position;
+      ms_target    = ms.target;
+      ms_stepcount = ms.stepcount;
+      ms_stepdir   = ms.stepdir;
+      ms_moving    = ms.moving;
+      __sync_synchronize();
+      seq++;
+    }
+
+    // take a consistent snapshot, retry if a writer was active
+    void read(MotionState &ms)
+    {
+      uint32_t s;
+      do
+      {
+        s = seq;
+        __sync_synchronize();
+        ms.position  = ms_position;
+        ms.target    = ms_target;
+        ms.stepcount = ms_stepcount;
+        ms.stepdir   = ms_stepdir;
+        ms.moving    = ms_moving;
+        __sync_synchronize();
+      } while ( (s & 1) || (s != seq) );
+    }
+
+  private:
+    volatile uint32_t      seq;
+    volatile unsigned long ms_position;
+    volatile unsigned long ms_target;
+    volatile uint32_t      ms_stepcount;
+    volatile bool          ms_stepdir;
+    volatile byte          ms_moving;
+};
+
+#endif // #ifndef motionstate_h
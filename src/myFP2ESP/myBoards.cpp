@@ -36,6 +36,14 @@
 // Read
 // code calls mySetupData->get_tmc2225current();
 
+// getmotionstate()
+// Write
+// the timer ISR publishes position and steps after each step, setposition() publishes the new position
+// loop() publishes ftargetPosition and isMoving by calling driverboard->setmotionstate(ftargetPosition, isMoving)
+// Read
+// code that reports position, target or moving state calls driverboard->getmotionstate(ms)
+// and uses the fields of that one snapshot
+
 // ======================================================================
 // Includes
 // ======================================================================
@@ -44,6 +52,8 @@
 #include "generalDefinitions.h"
 #include "myBoards.h"
 #include "FocuserSetupData.h"
+#include "ramp.h"
+#include "velocity.h"
 
 // ======================================================================
 // Externs
@@ -66,6 +76,21 @@ extern portMUX_TYPE  stepcountMux;
 // Data
 // ======================================================================
 bool stepdir;                                 // direction of steps to move
+volatile uint32_t blstepcount;                // backlash steps still to take, part of stepcount but do not change position
+volatile byte hpswstop = HPSW_STOPCLOSED;     // when the home position switch ends a move
+byte movespeed = MOVESPEEDSETTING;            // motorspeed of the next move, MOVESPEEDSETTING = use setting
+
+// two phase moves on TMC boards: the slew runs in the coarse step mode, the last part in the fine step mode.
+// focuser position is always in fine steps, each coarse step moves it by stepweight
+byte movephase = PHASE_NONE;                  // PHASE_NONE or PHASE_COARSE
+volatile uint32_t stepweight = 1;             // fine steps per step of the running move
+int movestepmode;                             // step mode of the running move
+unsigned long phasesteps;                     // fine steps left for the fine phase
+unsigned long phasebacklash;                  // backlash steps left for the fine phase
+
+// motion state snapshot, see motionstate.h
+// writers are the timer ISR and loop(), they are serialized by stepcountMux (ESP32) or disabled interrupts (ESP8266)
+MotionSeqlock motionlock;
 
 // ======================================================================
 // timer Interrupt
@@ -79,14 +104,19 @@ hw_timer_t * myfp2timer = NULL;               // use a unique name for the timer
 #endif
 
 /*
-  if (stepcount  && !(driverboard->hpsw_alert() && stepdir == moving_in))
-
-  stepcount   stepdir        hpsw_alert     action
-  ----------------------------------------------------
-    0           x             x             stop
-    >0          moving_out    x             step
-    >0          moving_in     False         step
-    >0          moving_in     True          stop
+  if (stepcount  && !hpsw_stop())
+
+  stepcount   hpswstop         stepdir        hpsw_closed    action
+  ---------------------------------------------------------------------
+    0           x                x             x             stop
+    >0          HPSW_STOPCLOSED  moving_out    x             step
+    >0          HPSW_STOPCLOSED  moving_in     False         step
+    >0          HPSW_STOPCLOSED  moving_in     True          stop
+    >0          HPSW_STOPOPEN    x             True          step
+    >0          HPSW_STOPOPEN    x             False         stop
+
+  for HPSW_STOPCLOSED, hpsw_closed is true if the switch has closed at any time since the move started,
+  see hpsw_isr()
 */
 
 inline void asm2uS()  __attribute__((always_inline));
@@ -144,26 +174,381 @@ inline void asm1uS()                  // 1uS on ESP8266, 1/3uS on ESP32
   );
 }
 
+// ======================================================================
+// Step interval ramp, see ramp.h
+// ======================================================================
+StepRamp ramp;                                // intervals of the running move
+bool homingmove = false;                      // homing moves end on the switch, no approach
+
+// reload the step timer with a new interval, safe to call from the timer ISR
+inline void IRAM_ATTR set_stepinterval(uint32_t us)
+{
+#if defined(ESP8266)
+  timer1_write(us * 5);                       // timer1 runs at 80MHz / TIM_DIV16 = 5 ticks per uS
+#else
+  timerAlarmWrite(myfp2timer, us, true);      // timer for ISR, interval time, reload=true
+#endif
+}
+
+// called by the ISR after each step to work out the interval to the next step
+inline void IRAM_ATTR ramp_nextinterval(void)
+{
+  uint32_t us = ramp.next(stepcount);
+  if ( us != 0 )
+  {
+    set_stepinterval(us);
+  }
+}
+
+// ======================================================================
+// Driver policies
+// ======================================================================
+// The step path of the timer ISR is specialized at compile time for the board family selected by DRVBRD.
+// Pins and settings are cached by begin() when a move is started, so step() does not call mySetupData
+// or walk the board number chain. CUSTOMBRD and boards without a policy use the chain in movemotor().
+#if !defined(ESP8266)
+#include "soc/gpio_struct.h"                  // GPIO set/clear registers
+#endif
+
+inline void fastpinwrite(uint8_t, uint8_t) __attribute__((always_inline));
+
+// write a gpio pin using the set/clear registers
+inline void fastpinwrite(uint8_t pin, uint8_t val)
+{
+#if defined(ESP8266)
+  if ( pin < 16 )
+  {
+    if ( val )
+    {
+      GPOS = (1 << pin);
+    }
+    else
+    {
+      GPOC = (1 << pin);
+    }
+  }
+  else
+  {
+    digitalWrite(pin, val);                   // GPIO16 is not in the gpio registers
+  }
+#else
+  if ( pin < 32 )
+  {
+    if ( val )
+    {
+      GPIO.out_w1ts = (1 << pin);
+    }
+    else
+    {
+      GPIO.out_w1tc = (1 << pin);
+    }
+  }
+  else
+  {
+    if ( val )
+    {
+      GPIO.out1_w1ts.val = (1 << (pin - 32));
+    }
+    else
+    {
+      GPIO.out1_w1tc.val = (1 << (pin - 32));
+    }
+  }
+#endif
+}
+
+// pick the motor object a coil policy drives
+inline HalfStepper* policymotor(HalfStepper *hs, Stepper *s, HalfStepper *)
+{
+  return hs;
+}
+
+inline Stepper* policymotor(HalfStepper *hs, Stepper *s, Stepper *)
+{
+  return s;
+}
+
+// in out leds, only on ESP32 boards
+template <bool HASLEDS>
+class LedPolicy
+{
+  public:
+    void begin(void)
+    {
+      leds      = HASLEDS && (mySetupData->get_inoutledstate() == 1);
+      inledpin  = mySetupData->get_brdinledpin();
+      outledpin = mySetupData->get_brdoutledpin();
+    }
+    inline void on(bool dir) __attribute__((always_inline))
+    {
+      if ( HASLEDS && leds )
+      {
+        fastpinwrite(( dir == moving_in ) ? inledpin : outledpin, 1);
+      }
+    }
+    inline void off(bool dir) __attribute__((always_inline))
+    {
+      if ( HASLEDS && leds )
+      {
+        fastpinwrite(( dir == moving_in ) ? inledpin : outledpin, 0);
+      }
+    }
+  private:
+    bool    leds;
+    uint8_t inledpin;
+    uint8_t outledpin;
+};
+
+// step and direction drivers, DRV8825, TMC2225, TMC2209
+template <bool HASLEDS>
+class StepDirPolicy
+{
+  public:
+    void begin(HalfStepper *hs, Stepper *s, unsigned int clk)
+    {
+      ledpolicy.begin();
+      reverse   = (mySetupData->get_reversedirection() == 1);
+      dirpin    = mySetupData->get_brddirpin();
+      steppin   = mySetupData->get_brdsteppin();
+      enablepin = mySetupData->get_brdenablepin();
+      fastclock = (clk != 160);
+    }
+    inline void step(bool dir) __attribute__((always_inline))
+    {
+      ledpolicy.on(dir);
+      fastpinwrite(dirpin, reverse ? !dir : dir);             // set Direction of travel
+      fastpinwrite(enablepin, 0);                             // Enable Motor Driver
+      fastpinwrite(steppin, 1);                               // Step pin on
+#if defined(ESP8266)
+      asm1uS();                                               // ESP8266 must be 2uS delay for DRV8825 chip
+      asm1uS();
+      asm1uS();
+#else
+      asm1uS();                                               // ESP32 must be 2uS delay for DRV8825 chip
+      asm1uS();
+      asm1uS();
+      asm1uS();
+      if ( fastclock )
+      {
+        asm1uS();                                             // 240mHz
+        asm1uS();
+      }
+#endif
+      fastpinwrite(steppin, 0);                               // Step pin off
+      ledpolicy.off(dir);
+    }
+    // hardware step generator move, direction and enable are set once, the led is on for the whole move
+    void hwbegin(bool dir)
+    {
+      fastpinwrite(dirpin, reverse ? !dir : dir);
+      fastpinwrite(enablepin, 0);
+      ledpolicy.on(dir);
+    }
+    void hwend(bool dir)
+    {
+      ledpolicy.off(dir);
+    }
+  private:
+    LedPolicy<HASLEDS> ledpolicy;
+    bool    reverse;
+    bool    fastclock;
+    uint8_t dirpin;
+    uint8_t steppin;
+    uint8_t enablepin;
+};
+
+// coil drivers, HalfStepper for ULN2003, L298N, L293DMINI, L9110S, Stepper for L293D
+template <bool HASLEDS, class MOTOR>
+class CoilPolicy
+{
+  public:
+    void begin(HalfStepper *hs, Stepper *s, unsigned int clk)
+    {
+      ledpolicy.begin();
+      motor = policymotor(hs, s, (MOTOR *) NULL);
+      fwd   = (mySetupData->get_reversedirection() == 1) ? -1 : 1;
+    }
+    inline void step(bool dir) __attribute__((always_inline))
+    {
+      ledpolicy.on(dir);
+      motor->step(( dir == moving_in ) ? -fwd : fwd);
+      asm1uS();
+      asm1uS();
+      ledpolicy.off(dir);
+    }
+  private:
+    LedPolicy<HASLEDS> ledpolicy;
+    MOTOR *motor;
+    int   fwd;
+};
+
+// runtime board number chain
+class RuntimePolicy
+{
+  public:
+    void begin(HalfStepper *hs, Stepper *s, unsigned int clk)
+    {
+    }
+    inline void step(bool dir) __attribute__((always_inline))
+    {
+      driverboard->movemotor(dir, false);
+    }
+};
+
+#if defined(MOVEMOTORRUNTIME)
+typedef RuntimePolicy DriverPolicy;
+#elif (DRVBRD == WEMOSDRV8825 || DRVBRD == PRO2EDRV8825 || DRVBRD == WEMOSDRV8825H || DRVBRD == PRO2ESP32R3WEMOS)
+typedef StepDirPolicy<false> DriverPolicy;
+#elif (DRVBRD == PRO2ESP32DRV8825 || DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
+typedef StepDirPolicy<true> DriverPolicy;
+#elif (DRVBRD == PRO2EULN2003 || DRVBRD == PRO2EL298N || DRVBRD == PRO2EL293DMINI || DRVBRD == PRO2EL9110S)
+typedef CoilPolicy<false, HalfStepper> DriverPolicy;
+#elif (DRVBRD == PRO2ESP32ULN2003 || DRVBRD == PRO2ESP32L298N || DRVBRD == PRO2ESP32L293DMINI || DRVBRD == PRO2ESP32L9110S)
+typedef CoilPolicy<true, HalfStepper> DriverPolicy;
+#elif (DRVBRD == PRO2EL293DNEMA || DRVBRD == PRO2EL293D28BYJ48)
+typedef CoilPolicy<false, Stepper> DriverPolicy;
+#else
+typedef RuntimePolicy DriverPolicy;           // CUSTOMBRD, or no policy for this board
+#endif
+
+DriverPolicy driverpolicy;
+bool usepolicy;                               // false if board number does not match DRVBRD
+
+// ======================================================================
+// Hardware step generator
+// ======================================================================
+// On ESP32 step/dir boards constant speed moves can be sent by the RMT peripheral, see stepgen.h.
+// The timer ISR is not armed for these moves, position is worked out from the pulse counter.
+#if defined(HWSTEPGEN) && !defined(ESP8266) && !defined(MOVEMOTORRUNTIME)
+#define USESTEPGEN
+#include "stepgen.h"
+
+RmtStepGenerator rmtstepgen;
+StepGenerator *stepgen = &rmtstepgen;
+bool stepgenok;                               // stepgen->begin() found the hardware
+bool hwmove;                                  // the running move uses stepgen, not the timer ISR
+StepGenMove hwmv;                             // position and steps of the running move from the pulses sent
+
+// stepgen done callback, runs in the RMT interrupt
+void IRAM_ATTR stepgen_done(void)
+{
+  varENTER_CRITICAL(&timerSemaphoreMux);
+  timerSemaphore = true;                                        // signal move complete
+  varEXIT_CRITICAL(&timerSemaphoreMux);
+}
+#endif
+
+#if defined(TIMEMOVEMOTOR)
+volatile uint32_t stepcycles;                 // cpu cycles spent in the step path
+volatile uint32_t stepsamples;
+#endif
+
+#if defined(STEPTRACE)
+// ring of the last STEPTRACESIZE timer ISR steps, read by the management server /steptrace
+#if defined(ESP8266)
+StepTraceEntry steptrace[STEPTRACESIZE];
+#else
+DRAM_ATTR StepTraceEntry steptrace[STEPTRACESIZE];
+#endif
+volatile uint32_t steptracehead;              // number of entries written, next index is steptracehead & (STEPTRACESIZE - 1)
+volatile bool steptraceon = true;             // false while the ring is read
+
+inline void IRAM_ATTR steptrace_record(uint32_t cycles, uint32_t info)
+{
+  if ( steptraceon )
+  {
+    uint32_t i = steptracehead & (STEPTRACESIZE - 1);
+    steptrace[i].cycles = cycles;
+    steptrace[i].info   = info;
+    steptracehead = steptracehead + 1;
+  }
+}
+#endif
+
+// ======================================================================
+// Home position switch interrupt
+// ======================================================================
+// The switch, or the TMC2209 DIAG output with USE_STALL_GUARD, raises an interrupt on each edge. The step
+// ISR only tests the flags. hpsw_irq() attaches the interrupt to follow the hpsw setting and resyncs the
+// flags when a move starts. Pins without an interrupt fall back to reading the switch before every step.
+volatile bool hpswclosed;                     // switch closed [DIAG high] now
+volatile bool hpswalert;                      // switch closed [stall seen] since the move started
+bool hpswattached;                            // interrupt attached to hpswpin
+bool hpswpolled;                              // no interrupt on hpswpin, step ISR reads the switch
+bool hpswdiag;                                // hpswpin is the TMC2209 DIAG output, high = stall
+int  hpswpin = -1;
+
+inline bool IRAM_ATTR hpsw_level(void)
+{
+  return hpswdiag ? (bool) digitalRead(hpswpin) : !( (bool) digitalRead(hpswpin) );
+}
+
+void IRAM_ATTR hpsw_isr(void)
+{
+  bool closed = hpsw_level();
+  hpswclosed = closed;
+  if ( closed )
+  {
+    hpswalert = true;                         // latched, a DIAG pulse or switch bounce cannot clear it
+  }
+}
+
+// true if the home position switch ends the running move
+inline bool IRAM_ATTR hpsw_stop(void)
+{
+  if ( hpswpolled )
+  {
+    if ( hpswstop == HPSW_STOPOPEN )
+    {
+      return !driverboard->hpsw_closed();                       // homing back off ends when the switch opens
+    }
+    return driverboard->hpsw_alert();                           // moving in ends when the switch closes
+  }
+  if ( hpswstop == HPSW_STOPOPEN )
+  {
+    return !hpswclosed;
+  }
+  return (stepdir == moving_in) && hpswalert;
+}
+
 // timer ISR  Interrupt Service Routine
 #if defined(ESP8266)
 //ICACHE_RAM_ATTR void onTimer()                        // DEPRECATED
 IRAM_ATTR void onTimer()
 {
   static bool mjob = false;                                     // motor job is running or not
-  if (stepcount  && !(driverboard->hpsw_alert() && stepdir == moving_in))
+#if defined(STEPTRACE)
+  uint32_t tracecycles = ESP.getCycleCount();                   // time the ISR was entered
+#endif
+  if (stepcount  && !hpsw_stop())
   {
-    driverboard->movemotor(stepdir, true);                      // move motor in direction and adjust position
+    bool blstep = (blstepcount != 0);
+    driverboard->stepmotor(!blstep);                            // move motor in direction, adjust position unless backlash
     varENTER_CRITICAL(&stepcountMux);
     stepcount--;                                                // decrement steps to move
+    if ( blstep )
+    {
+      blstepcount--;                                            // backlash steps are taken first
+    }
+    driverboard->publishmotionstate();
     varEXIT_CRITICAL(&stepcountMux);
+#if defined(STEPTRACE)
+    steptrace_record(tracecycles, (stepcount & TRACE_STEPMASK) | ((stepdir == moving_out) ? TRACE_OUT : 0) | (blstep ? TRACE_BACKLASH : 0));
+#endif
+    ramp_nextinterval();                                        // adjust step interval if ramping
     mjob = true;                                                // mark a running job
   }
   else
   {
     if (mjob == true)
     {
+#if defined(STEPTRACE)
+      steptrace_record(tracecycles, (stepcount & TRACE_STEPMASK) | TRACE_END | (stepcount ? TRACE_HPSW : 0));
+#endif
       varENTER_CRITICAL(&stepcountMux);
       stepcount = 0;                                            // just in case hps_alert was fired up
+      blstepcount = 0;
+      driverboard->publishmotionstate();
       varEXIT_CRITICAL(&stepcountMux);
       mjob = false;                                             // wait, and do nothing
       varENTER_CRITICAL(&timerSemaphoreMux);
@@ -176,20 +561,38 @@ IRAM_ATTR void onTimer()
 void IRAM_ATTR onTimer()
 {
   static bool mjob = false;                                     // motor job is running or not
-  if (stepcount  && !(driverboard->hpsw_alert() && stepdir == moving_in))
+#if defined(STEPTRACE)
+  uint32_t tracecycles = ESP.getCycleCount();                   // time the ISR was entered
+#endif
+  if (stepcount  && !hpsw_stop())
   {
-    driverboard->movemotor(stepdir, true);
+    bool blstep = (blstepcount != 0);
+    driverboard->stepmotor(!blstep);
     varENTER_CRITICAL(&stepcountMux);
     stepcount--;
+    if ( blstep )
+    {
+      blstepcount--;                                            // backlash steps are taken first
+    }
+    driverboard->publishmotionstate();
     varEXIT_CRITICAL(&stepcountMux);
+#if defined(STEPTRACE)
+    steptrace_record(tracecycles, (stepcount & TRACE_STEPMASK) | ((stepdir == moving_out) ? TRACE_OUT : 0) | (blstep ? TRACE_BACKLASH : 0));
+#endif
+    ramp_nextinterval();
     mjob = true;                                                // mark a running job
   }
   else
   {
     if (mjob == true)
     {
+#if defined(STEPTRACE)
+      steptrace_record(tracecycles, (stepcount & TRACE_STEPMASK) | TRACE_END | (stepcount ? TRACE_HPSW : 0));
+#endif
       varENTER_CRITICAL(&stepcountMux);
       stepcount = 0;              // just in case hps_alert was fired up
+      blstepcount = 0;
+      driverboard->publishmotionstate();
       varEXIT_CRITICAL(&stepcountMux);
       mjob = false;               // wait, and do nothing
       varENTER_CRITICAL(&timerSemaphoreMux);
@@ -222,7 +625,21 @@ DriverBoard::DriverBoard(unsigned long startposition)
     stepcount = 0;
     varEXIT_CRITICAL(&stepcountMux);
 
+    // the step timer is allocated once, moves only arm and disarm it
+#if defined(ESP8266)
+    myfp2Timer.attachInterruptInterval(RAMPMAXINTERVAL, onTimer);
+    myfp2Timer.disableTimer();
+#else
+    // Use 1st timer of 4 (counted from zero).
+    // Set 80 divider for prescaler (see ESP32 Technical Reference Manual)
+    myfp2timer = timerBegin(0, 80, true);                       // timer-number, prescaler, count up (true) or down (false)
+    timerAttachInterrupt(myfp2timer, &onTimer, true);           // our handler name, address of function int handler, edge=true
+#endif
+
     boardnum = mySetupData->get_brdnumber();                    // get board number and cache it locally here
+#if defined(USESTEPGEN)
+    stepgenok = (boardnum == DRVBRD) && stepgen->begin(mySetupData->get_brdsteppin(), stepgen_done);
+#endif
 
     if ( boardnum == WEMOSDRV8825 || boardnum == PRO2EDRV8825 || boardnum == PRO2ESP32R3WEMOS || boardnum == WEMOSDRV8825H )
     {
@@ -405,11 +822,57 @@ bool DriverBoard::init_hpsw(void)
   if ( mySetupData->get_hpswitchenable() == 1)
   {
     pinMode(mySetupData->get_brdhpswpin(), INPUT_PULLUP);       // initialize the pin - should work for both methods
+    this->hpsw_irq();
     return true;
   }
+  this->hpsw_irq();
   return false;
 }
 
+// attach or detach the home position switch interrupt to follow the hpsw setting, and resync the flags
+// with the switch. Called by init_hpsw() and at the start of each move
+void DriverBoard::hpsw_irq(void)
+{
+  int  pin    = mySetupData->get_brdhpswpin();
+  bool enable = (mySetupData->get_hpswitchenable() == 1) && (pin != -1);
+  if ( (enable != (hpswattached || hpswpolled)) || (enable && (pin != hpswpin)) )
+  {
+    if ( hpswattached )
+    {
+      detachInterrupt(digitalPinToInterrupt(hpswpin));
+    }
+    hpswattached = false;
+    hpswpolled   = false;
+    if ( enable )
+    {
+      hpswpin = pin;
+#if defined(USE_STALL_GUARD)
+      hpswdiag = (this->boardnum == PRO2ESP32TMC2209) || (this->boardnum == PRO2ESP32TMC2209P);
+#else
+      hpswdiag = false;
+#endif
+#if defined(ESP8266)
+      if ( (digitalPinToInterrupt(pin) < 0) || (pin == 16) )     // GPIO16 has no interrupt
+#else
+      if ( digitalPinToInterrupt(pin) < 0 )
+#endif
+      {
+        hpswpolled = true;
+      }
+      else
+      {
+        attachInterrupt(digitalPinToInterrupt(pin), hpsw_isr, CHANGE);
+        hpswattached = true;
+      }
+    }
+    Board_DebugPrint("hpsw_irq: ");
+    Board_DebugPrintln(hpswattached);
+  }
+  bool closed = hpswattached && hpsw_level();
+  hpswclosed = closed;
+  hpswalert  = closed;
+}
+
 void DriverBoard::init_tmc2209(void)
 {
 #if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
@@ -417,34 +880,34 @@ void DriverBoard::init_tmc2209(void)
   mytmcstepper = new TMC2209Stepper(&SERIAL_PORT2, R_SENSE, DRIVER_ADDRESS);
   Serial2.begin(TMC2209SPEED);
   mytmcstepper->begin();
+  tmcshadow.begin(mytmcstepper);
   mytmcstepper->pdn_disable(1);                                 // Use PDN/UART pin for communication
   mytmcstepper->mstep_reg_select(1);                            // Adjust stepMode from the registers
   mytmcstepper->I_scale_analog(0);                              // Adjust current from the registers
   mytmcstepper->toff(TOFF_VALUE);                               // use TMC22xx Calculations sheet to get these
   mytmcstepper->tbl(2);
-  mytmcstepper->rms_current(mySetupData->get_tmc2209current()); // set driver current mA
-  int sm = mySetupData->get_brdstepmode();                      // stepmode set according to mySetupData->get_brdstepmode()
-  sm = (sm == STEP1) ? 0 : sm;                                  // handle full steps
-  mytmcstepper->microsteps(sm);                                 // set micro stepping
+  tmcshadow.set(TMCREG_CURRENT, mySetupData->get_tmc2209current()); // set driver current mA
+  this->setmicrosteps(mySetupData->get_brdstepmode());          // stepmode set according to mySetupData->get_brdstepmode()
 
-  // stall guard settings
-  mytmcstepper->semin(0);
+  // stall guard settings, CoolStep and the StealthChop/SpreadCycle threshold are set for each move by tmcvelocity()
+  tmcshadow.set(TMCREG_SEMIN, 0);                               // CoolStep off
   // lower threshold velocity for switching on smart energy CoolStep and StallGuard to DIAG output
-  mytmcstepper->TCOOLTHRS(0xFFFFF);                             // 20bit max
+  tmcshadow.set(TMCREG_TCOOLTHRS, TMCTSTEPMAX);                 // 20bit max
+  tmcshadow.set(TMCREG_TPWMTHRS, 0);                            // StealthChop only
   mytmcstepper->hysteresis_end(0);                              // use TMC22xx Calculations sheet to get these
   mytmcstepper->hysteresis_start(0);                            // use TMC22xx Calculations sheet to get these
   //mytmcstepper->irun(4);
   //mytmcstepper->toff(5);
-  //mytmcstepper->pwm_autoscale(true);
-  //mytmcstepper->semin(5);
-  //mytmcstepper->semax(2);
-  //mytmcstepper->sedn(0b01);
+  mytmcstepper->pwm_autoscale(true);                            // StealthChop current regulation
+  mytmcstepper->semax(COOLSTEPSEMAX);
+  mytmcstepper->sedn(0b01);                                     // CoolStep current down by 1 every 8 SG results
   // StallGuard4 threshold [0... 255] level for stall detection. It compensates for
   // motor specific characteristics and controls sensitivity. A higher value gives a higher
   // sensitivity. A higher value makes StallGuard4 more sensitive and requires less torque to
   // indicate a stall. The double of this value is compared to SG_RESULT.
   // The stall output becomes active if SG_RESULT falls below this value.
-  mytmcstepper->SGTHRS(mySetupData->get_stallguard());
+  tmcshadow.set(TMCREG_SGTHRS, mySetupData->get_stallguard());
+  tmcshadow.flush();
   Board_DebugPrint("TMC2209 Status: ");
   //Board_DebugPrintln( driver.test_connection() == 0 ? "OK" : "NOT OK" );
   Board_DebugPrint("Motor is ");
@@ -460,16 +923,17 @@ void DriverBoard::init_tmc2225(void)
   mytmcstepper = new TMC2208Stepper(&SERIAL_PORT2);               // specify the serial2 interface to the tmc2225
   Serial2.begin(TMC2225SPEED);
   mytmcstepper.begin();
+  tmcshadow.begin(mytmcstepper);
   mytmcstepper->pdn_disable(1);                                   // use PDN/UART pin for communication
   mytmcstepper->mstep_reg_select(true);
   mytmcstepper->I_scale_analog(0);                                // adjust current from the registers
-  mytmcstepper->rms_current(mySetupData->get_tmc2225current());   // set driver current [recommended NEMA = 400mA, set to 300mA]
+  tmcshadow.set(TMCREG_CURRENT, mySetupData->get_tmc2225current()); // set driver current [recommended NEMA = 400mA, set to 300mA]
   mytmcstepper->toff(2);                                          // enable driver
-  int sm = mySetupData->get_brdstepmode();                        // stepmode set according to mySetupData->get_brdstepmode();
-  sm = (sm == STEP1) ? 0 : sm;                                    // handle full steps
-  mytmcstepper->microsteps(sm);                                   // step mode = 1/4 - default specified in boardfile.jsn
+  this->setmicrosteps(mySetupData->get_brdstepmode());            // step mode = 1/4 - default specified in boardfile.jsn
   mytmcstepper->hysteresis_end(0);
   mytmcstepper->hysteresis_start(0);
+  tmcshadow.set(TMCREG_TPWMTHRS, 0);                              // StealthChop only, set for each move by tmcvelocity()
+  tmcshadow.flush();
   Board_DebugPrint("TMC2225 Status: ");
   Board_DebugPrintln( driver.test_connection() == 0 ? "OK" : "NOT OK" );
   Board_DebugPrint("Motor is ");
@@ -486,11 +950,21 @@ void DriverBoard::init_tmc2225(void)
 // hps_alert must return high if hpsw or stall guard is activated
 bool DriverBoard::hpsw_alert(void)
 {
-  // if moving out OR hpsw is not enabled then return
+  // if moving out then return
   if ( stepdir == moving_out )
   {
     return false;
   }
+  if ( hpswattached )
+  {
+    return hpswalert;                                           // also catches a DIAG pulse that has ended
+  }
+  return this->hpsw_closed();
+}
+
+// state of the home position switch (or stall guard) regardless of the direction of travel, true if closed
+bool DriverBoard::hpsw_closed(void)
+{
   // if hpsw is not enabled then return false
   if ( mySetupData->get_hpswitchenable() == 0 )
   {
@@ -606,21 +1080,58 @@ void DriverBoard::setstepmode(int smode)
     {
       smode = (smode < STEP1)   ? STEP1   : smode;
       smode = (smode > STEP256) ? STEP256 : smode;
-      // handle full stepmode
-      smode = (smode == STEP1) ? 0 : smode;
-#if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
-      // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
-      mytmcstepper->microsteps(smode);
-#endif // #if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
-      if (smode == 0)
-      {
-        smode = STEP1;
-      }
+      this->setmicrosteps(smode);
       mySetupData->set_brdstepmode( smode );
     }
   } while (0);
 }
 
+// set the microstep resolution of a TMC driver, without changing the step mode setting. Written by the next
+// initmove() or tmcpoll()
+void DriverBoard::setmicrosteps(int smode)
+{
+#if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+  // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
+  tmcshadow.set(TMCREG_MRES, (smode == STEP1) ? 0 : smode);    // handle full stepmode
+#endif // #if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+}
+
+// fine steps per coarse step for two phase moves, 0 if the board or the coarse step mode setting does not allow it
+unsigned long DriverBoard::coarseratio(void)
+{
+  if ( this->boardnum != PRO2ESP32TMC2225 && this->boardnum != PRO2ESP32TMC2209 && this->boardnum != PRO2ESP32TMC2209P )
+  {
+    return 0;
+  }
+  int fine   = mySetupData->get_brdstepmode();
+  int coarse = mySetupData->get_coarsestepmode();
+  if ( (coarse < STEP1) || (coarse >= fine) || (fine > STEP256) || ((fine & (fine - 1)) != 0) || ((coarse & (coarse - 1)) != 0) )
+  {
+    return 0;
+  }
+  return fine / coarse;
+}
+
+// a coarse slew has ended, start the fine phase of the move. returns false if there is no fine phase,
+// the move was stopped early or by the home position switch, the caller then ends the move as usual
+bool DriverBoard::nextphase(void)
+{
+  varENTER_CRITICAL(&stepcountMux);
+  uint32_t left = stepcount;
+  varEXIT_CRITICAL(&stepcountMux);
+  if ( (movephase != PHASE_COARSE) || (left != 0) || ((phasesteps + phasebacklash) == 0) || this->hpsw_alert() )
+  {
+    return false;
+  }
+  byte mspeed = movespeed;
+  this->end_move();                                             // also back to the fine step mode
+  movespeed = mspeed;
+  Board_DebugPrint("nextphase: ");
+  Board_DebugPrintln(phasesteps);
+  this->initmove(stepdir, phasesteps, phasebacklash);
+  return true;
+}
+
 void DriverBoard::enablemotor(void)
 {
   if (boardnum == WEMOSDRV8825     || boardnum == PRO2EDRV8825     || boardnum == PRO2ESP32DRV8825 || boardnum == PRO2ESP32R3WEMOS \
@@ -780,40 +1291,128 @@ void DriverBoard::movemotor(byte ddir, bool updatefpos)
   }
 }
 
-// when a move has completed [or halted], we need to detach/disable the interrupt timers
+// take one step in stepdir and update position if updatefpos, called by the timer ISR
+void IRAM_ATTR DriverBoard::stepmotor(bool updatefpos)
+{
+#if defined(TIMEMOVEMOTOR)
+  uint32_t cstart = ESP.getCycleCount();
+#endif
+  if ( usepolicy )
+  {
+    driverpolicy.step(stepdir);
+  }
+  else
+  {
+    this->movemotor(stepdir, false);
+  }
+  if ( updatefpos )
+  {
+    ( stepdir == moving_in ) ? this->focuserposition -= stepweight : this->focuserposition += stepweight;
+  }
+#if defined(TIMEMOVEMOTOR)
+  stepcycles += ESP.getCycleCount() - cstart;
+  stepsamples++;
+#endif
+}
+
+// when a move has completed [or halted], disarm the step timer
+// the timer stays allocated and attached, so this does not need to wait
 void DriverBoard::end_move(void)
 {
 #if defined(ESP8266)
-  myfp2Timer.detachInterrupt();
+  myfp2Timer.disableTimer();
 #else
   timerAlarmDisable(myfp2timer);      // stop alarm
-  timerDetachInterrupt(myfp2timer);   // detach interrupt
-  timerEnd(myfp2timer);               // end timer
 #endif
+#if defined(USESTEPGEN)
+  if ( hwmove )
+  {
+    // if halted, the pulses already in the RMT memory are still sent, give the cpu to other tasks meanwhile
+    stepgen->settotal(0);
+    unsigned long tstart = millis();
+    while ( stepgen->busy() && ((millis() - tstart) < STEPGEN_STOPTIMEOUT) )
+    {
+      vTaskDelay(1);
+    }
+    this->stepgenupdate();
+    stepgen->end();
+    driverpolicy.hwend(stepdir);
+    hwmove = false;
+  }
+#endif
+  varENTER_CRITICAL(&stepcountMux);   // no steps left if halted
+  stepcount = 0;
+  blstepcount = 0;
+  varEXIT_CRITICAL(&stepcountMux);
+  if ( movephase == PHASE_COARSE )
+  {
+    this->setmicrosteps(mySetupData->get_brdstepmode());   // back to the fine step mode
+    movephase = PHASE_NONE;
+  }
+  stepweight = 1;
+  hpswstop = HPSW_STOPCLOSED;         // back to normal moves
+  homingmove = false;
+  movespeed = MOVESPEEDSETTING;
   Board_DebugPrintln("halt:");
-  delay(10);
+#if defined(TIMEMOVEMOTOR)
+  Serial.print("movemotor cycles/step: ");
+  Serial.println( (stepsamples != 0) ? stepcycles / stepsamples : 0 );
+  stepcycles = 0;
+  stepsamples = 0;
+#endif
 }
 
-void DriverBoard::initmove(bool mdir, unsigned long steps)
+// start a move of steps in direction mdir, the backlash steps are taken first and do not change the position
+void DriverBoard::initmove(bool mdir, unsigned long steps, unsigned long backlash)
 {
+  movephase    = PHASE_NONE;
+  stepweight   = 1;
+  movestepmode = mySetupData->get_brdstepmode();
+  unsigned long ratio = this->coarseratio();
+  if ( (ratio > 1) && (homingmove == false) && (steps >= mySetupData->get_finesteps() + ratio) )
+  {
+    // slew in the coarse step mode, nextphase() runs the rest in the fine step mode
+    unsigned long coarse = (steps - mySetupData->get_finesteps()) / ratio;
+    phasesteps    = steps - coarse * ratio;
+    phasebacklash = backlash % ratio;
+    steps         = coarse;
+    backlash      = backlash / ratio;
+    movephase     = PHASE_COARSE;
+    stepweight    = ratio;
+    movestepmode  = mySetupData->get_coarsestepmode();
+    this->setmicrosteps(movestepmode);
+  }
   stepdir = mdir;
-  varENTER_CRITICAL(&stepcountMux);        // make sure stepcount is 0 when driverboard created
-  stepcount = steps;
+  varENTER_CRITICAL(&stepcountMux);
+  stepcount = steps + backlash;
+  blstepcount = backlash;
   varEXIT_CRITICAL(&stepcountMux);
   DriverBoard::enablemotor();
   varENTER_CRITICAL(&timerSemaphoreMux);
   timerSemaphore = false;
   varEXIT_CRITICAL(&timerSemaphoreMux);
+  usepolicy = (this->boardnum == DRVBRD);                   // cache pins and settings for the step path
+  driverpolicy.begin(myhstepper, mystepper, clock_frequency);
+  this->hpsw_irq();
 
   Board_DebugPrint("initmove: ");
   Board_DebugPrint(mdir);
   Board_DebugPrint(" : ");
-  Board_DebugPrintln(steps);
+  Board_DebugPrint(steps);
+  Board_DebugPrint(" : ");
+  Board_DebugPrintln(backlash);
+
+  // motorspeed of the move, a queue segment or homing move overrides the setting. Speed, approach and ramp
+  // all use this one choice
+  byte mspeed = ( movespeed == MOVESPEEDSETTING ) ? mySetupData->get_motorspeed() : movespeed;
+  Board_DebugPrint("motorspeed: ");
+  Board_DebugPrintln(mspeed);
 
 #if defined(ESP8266)
   // ESP8266
-  unsigned long curspd = mySetupData->get_brdmsdelay();     // get current board speed delay value
-  switch ( mySetupData->get_motorspeed() )
+  unsigned long curspd = this->velocityinterval();          // step interval for the fast motorspeed
+  this->initapproach(curspd, mspeed, steps);
+  switch ( mspeed )
   {
     case 0: // slow, 1/3rd the speed
       curspd *= 3;
@@ -822,55 +1421,12 @@ void DriverBoard::initmove(bool mdir, unsigned long steps)
       curspd *= 2;
       break;
   }
-  if (myfp2Timer.attachInterruptInterval(curspd, onTimer) == false)
-  {
-    Board_DebugPrintln("Cannot set myfp2Timer correctly. Select another freq. or interval");
-  }
+  curspd = this->initramp(curspd, mspeed);                  // interval of first step if ramping
+  myfp2Timer.enableTimer();                                 // arm timer
+  set_stepinterval(curspd);
 #else
   // ESP32
-  // Use 1st timer of 4 (counted from zero).
-  // Set 80 divider for prescaler (see ESP32 Technical Reference Manual)
-  myfp2timer = timerBegin(0, 80, true);                     // timer-number, prescaler, count up (true) or down (false)
-  timerAttachInterrupt(myfp2timer, &onTimer, true);         // our handler name, address of function int handler, edge=true
-
-  unsigned long curspd = mySetupData->get_brdmsdelay();     // get current board speed delay value
-  // handle the board step delays for TMC22xx steppers differently
-  if ( this->boardnum == PRO2ESP32TMC2225 || this->boardnum == PRO2ESP32TMC2209 || this->boardnum == PRO2ESP32TMC2209P)
-  {
-    switch ( mySetupData->get_brdstepmode() )
-    {
-      case STEP1:
-        curspd = curspd;
-        break;
-      case STEP2:
-        curspd = curspd / 2;
-        break;
-      case STEP4:
-        curspd = curspd / 4;
-        break;
-      case STEP8:
-        curspd = curspd / 8;
-        break;
-      case STEP16:
-        curspd = curspd / 16;
-        break;
-      case STEP32:
-        curspd = curspd / 32;
-        break;
-      case STEP64:
-        curspd = curspd / 64;
-        break;
-      case STEP128:
-        curspd = curspd / 128;
-        break;
-      case STEP256:
-        curspd = curspd / 256;
-        break;
-      default:
-        curspd = curspd / 4;
-        break;
-    }
-  }
+  unsigned long curspd = this->velocityinterval();          // step interval for the fast motorspeed
 
   Board_DebugPrint("cursp: ");
   Board_DebugPrintln(curspd);
@@ -880,9 +1436,8 @@ void DriverBoard::initmove(bool mdir, unsigned long steps)
   byte sgval = mySetupData->get_stallguard();
   Board_DebugPrint("stallguard: ");
   Board_DebugPrintln(sgval);
-  Board_DebugPrint("motorspeed: ");
-  Board_DebugPrintln(mySetupData->get_motorspeed());
-  switch ( mySetupData->get_motorspeed() )
+  this->initapproach(curspd, mspeed, steps);
+  switch ( mspeed )
   {
     case 0: // slow, 1/3rd the speed
       curspd *= 3;
@@ -900,40 +1455,315 @@ void DriverBoard::initmove(bool mdir, unsigned long steps)
   Board_DebugPrint("SG value to write: "); Board_DebugPrintln(sgval);
 #if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
   // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
-  mytmcstepper->SGTHRS(sgval);
+  tmcshadow.set(TMCREG_SGTHRS, sgval);
+#endif
+  curspd = this->initramp(curspd, mspeed);                  // interval of first step if ramping, sets the TMC thresholds
+#if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+  tmcshadow.flush();                                        // step mode and settings changed since the last move
+#endif
+#if defined(USESTEPGEN)
+  // constant speed moves that the home position switch cannot end are sent by the hardware step generator
+  hwmove = stepgenok && usepolicy && (ramp.mode == RAMP_NONE) && (ramp.approach_steps == 0) && (hpswstop == HPSW_STOPCLOSED)
+           && !((mdir == moving_in) && (mySetupData->get_hpswitchenable() == 1))
+           && (curspd >= STEPGEN_MININTERVAL) && (curspd <= STEPGEN_MAXINTERVAL) && ((steps + backlash) != 0);
+  if ( hwmove )
+  {
+    hwmv.start(this->focuserposition, backlash, steps, mdir, stepweight);
+    driverpolicy.hwbegin(mdir);
+    stepgen->start(hwmv.total, curspd);
+    Board_DebugPrintln("initmove: stepgen");
+    return;
+  }
 #endif
   // Set alarm to call onTimer function every interval value curspd (value in microseconds).
   // Repeat the alarm (third parameter)
+  timerWrite(myfp2timer, 0);                   // restart count so first step is a full interval
   timerAlarmWrite(myfp2timer, curspd, true);   // timer for ISR, interval time, reload=true
   timerAlarmEnable(myfp2timer);                // start timer alarm
 #endif
 }
 
+// start a homing move of at most steps in direction mdir, stopon is HPSW_STOPCLOSED or HPSW_STOPOPEN
+// the focuser position is updated as for a normal move, the caller sets the home position when the move ends
+void DriverBoard::inithomemove(bool mdir, unsigned long steps, byte stopon, bool slow)
+{
+  hpswstop = stopon;
+  homingmove = true;
+  movespeed = ( slow == true ) ? 0 : MOVESPEEDSETTING;
+  this->initmove(mdir, steps, 0);
+}
+
+// set the motorspeed 0-2 of the next move only, MOVESPEEDSETTING uses the motorspeed setting
+void DriverBoard::setmovespeed(byte mspeed)
+{
+  movespeed = ( mspeed > 2 ) ? MOVESPEEDSETTING : mspeed;
+}
+
+// change the target of a running move without stopping the timer
+// returns true if the running move now ends at the new target. If the new target needs a change of direction,
+// or is closer than the steps needed to stop, the move is shortened to a controlled stop and false is returned.
+// The caller must then start a new move from the stop position.
+bool DriverBoard::retargetmove(unsigned long target)
+{
+  bool retval = false;
+  if ( movephase == PHASE_COARSE )
+  {
+    // coarse steps are not fine steps, stop without a fine phase, the caller starts a new move
+    phasesteps    = 0;
+    phasebacklash = 0;
+    target = this->getposition();
+  }
+#if defined(USESTEPGEN)
+  if ( hwmove )
+  {
+    // the pulses already in the RMT memory are the steps needed to stop
+    uint32_t newtotal = hwmv.retarget(stepgen->stepsdone(), target);
+    uint32_t total = stepgen->settotal(newtotal);
+    retval = (newtotal != 0) && (total == newtotal);
+    varENTER_CRITICAL(&stepcountMux);
+    hwmv.total = total;
+    varEXIT_CRITICAL(&stepcountMux);
+    this->stepgenupdate();
+    Board_DebugPrint("retargetmove: stepgen ");
+    Board_DebugPrint(target);
+    Board_DebugPrint(" : ");
+    Board_DebugPrintln(retval);
+    return retval;
+  }
+#endif
+#if defined(ESP8266)
+  noInterrupts();                               // the timer ISR must not step between the read and the write
+#endif
+  varENTER_CRITICAL(&stepcountMux);
+  unsigned long pos = this->focuserposition;
+  bool mdir = (target > pos) ? moving_out : moving_in;
+  unsigned long steps = (target > pos) ? target - pos : pos - target;
+  uint32_t stopsteps = ramp.stopsteps();
+  if ( (steps != 0) && (mdir == stepdir) && (steps >= stopsteps) )
+  {
+    stepcount = steps + blstepcount;
+    retval = true;
+  }
+  else
+  {
+    // stop as soon as possible, but always finish the backlash steps
+    ramp.approach_steps = 0;
+    stepcount = ( stepcount < stopsteps ) ? stepcount : stopsteps;
+    stepcount = ( stepcount < blstepcount ) ? blstepcount : stepcount;
+  }
+  varEXIT_CRITICAL(&stepcountMux);
+#if defined(ESP8266)
+  interrupts();
+#endif
+
+  Board_DebugPrint("retargetmove: ");
+  Board_DebugPrint(target);
+  Board_DebugPrint(" : ");
+  Board_DebugPrintln(retval);
+  return retval;
+}
+
+// shortest safe step interval [uS] of the board at the step mode of the running move, see velocity.h
+unsigned long DriverBoard::mininterval(void)
+{
+  bool tmc = (this->boardnum == PRO2ESP32TMC2225 || this->boardnum == PRO2ESP32TMC2209 || this->boardnum == PRO2ESP32TMC2209P);
+  return board_mininterval(mySetupData->get_brdmsdelay(), tmc, movestepmode);
+}
+
+// step interval [uS] for motorspeed FAST, from the motorvelocity setting if set, else the board msdelay
+unsigned long DriverBoard::velocityinterval(void)
+{
+  return fast_interval(mySetupData->get_motorvelocity(), mySetupData->get_velocityunit(), movestepmode,
+                       mySetupData->get_stepsize(), this->mininterval());
+}
+
+// TSTEP of a step interval [uS] at step mode smode, the driver measures TSTEP per 1/256 microstep
+uint32_t tmc_tstep(unsigned long interval, int smode)
+{
+  uint64_t tstep = ((uint64_t) interval * (TMCFCLK / 1000000L) * smode) / 256;
+  return ( tstep > TMCTSTEPMAX ) ? TMCTSTEPMAX : (uint32_t) tstep;
+}
+
+// set the TMC velocity thresholds for a move, cruisespd is the step interval of the move at cruise speed.
+// Above spreadvelocity the driver changes from StealthChop to SpreadCycle. CoolStep is on from half the
+// cruise speed, unless stall guard homing needs StallGuard at all speeds.
+void DriverBoard::tmcvelocity(unsigned long cruisespd)
+{
+#if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+  int fine = mySetupData->get_brdstepmode();
+  unsigned long spread = velocity_interval(mySetupData->get_spreadvelocity(), mySetupData->get_velocityunit(), fine, mySetupData->get_stepsize());
+  tmcshadow.set(TMCREG_TPWMTHRS, ( spread != 0 ) ? tmc_tstep(spread, fine) : 0);
+#if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+  bool cool = (mySetupData->get_coolstep() == 1);
+  tmcshadow.set(TMCREG_SEMIN, cool ? COOLSTEPSEMIN : 0);
+#if defined(USE_STALL_GUARD)
+  tmcshadow.set(TMCREG_TCOOLTHRS, TMCTSTEPMAX);
+#else
+  tmcshadow.set(TMCREG_TCOOLTHRS, cool ? tmc_tstep(cruisespd * 2, movestepmode) : TMCTSTEPMAX);
+#endif
+#endif
+#endif
+}
+
+// setup the slow final approach of a move when motorspeed change is enabled. fastspd is the step interval
+// of the fast motorspeed, mspeed the motorspeed of the move
+void DriverBoard::initapproach(unsigned long fastspd, byte mspeed, unsigned long steps)
+{
+  unsigned long threshold = mySetupData->get_motorspeedthreshold();
+  ramp.approach_steps = 0;
+  if ( (mySetupData->get_motorspeedchange() == 1) && (mspeed != SLOW) && (homingmove == false) && (movephase == PHASE_NONE)
+       && (threshold != 0) && (steps > threshold) )
+  {
+    ramp.approach_interval = fastspd * 3;       // slow, 1/3rd the speed
+    ramp.approach_steps    = threshold;
+  }
+  Board_DebugPrint("approach: ");
+  Board_DebugPrintln(ramp.approach_steps);
+}
+
+// setup the step interval ramp for a move, curspd is the constant step interval [uS] for mspeed, the motorspeed
+// of the move. returns the interval to use for the first step. The TMC thresholds are set from the cruise
+// interval, which motormaxspeed can make faster than curspd
+unsigned long DriverBoard::initramp(unsigned long curspd, byte mspeed)
+{
+  float cmin = ramp_cruise(curspd, mySetupData->get_motormaxspeed(), this->mininterval(), mspeed);
+  uint32_t c0 = ramp.setup(cmin, mySetupData->get_motoraccel(), mySetupData->get_motorprofile());
+  this->tmcvelocity((unsigned long) cmin);
+
+  Board_DebugPrint("ramp mode: ");
+  Board_DebugPrint(ramp.mode);
+  Board_DebugPrint(" c0: ");
+  Board_DebugPrint(c0);
+  Board_DebugPrint(" cmin: ");
+  Board_DebugPrintln(cmin);
+  return c0;
+}
+
 unsigned long DriverBoard::getposition(void)
 {
+  this->stepgenupdate();
   return this->focuserposition;
 }
 
 void DriverBoard::setposition(unsigned long pos)
 {
+#if defined(ESP8266)
+  noInterrupts();
+#endif
+  varENTER_CRITICAL(&stepcountMux);
   this->focuserposition = pos;
+  this->publishmotionstate();
+  varEXIT_CRITICAL(&stepcountMux);
+#if defined(ESP8266)
+  interrupts();
+#endif
+}
+
+// publish position, steps and direction to the motion state snapshot
+// caller must hold stepcountMux (ESP32) or have interrupts disabled (ESP8266)
+void IRAM_ATTR DriverBoard::publishmotionstate(void)
+{
+  motionlock.update(this->focuserposition, stepcount, stepdir);
+}
+
+// publish target and moving state from loop(), together with the current position
+void DriverBoard::setmotionstate(unsigned long target, byte moving)
+{
+  this->stepgenupdate();
+#if defined(ESP8266)
+  noInterrupts();
+#endif
+  MotionState ms;
+  varENTER_CRITICAL(&stepcountMux);
+  ms.position  = this->focuserposition;
+  ms.target    = target;
+  ms.stepcount = stepcount;
+  ms.stepdir   = stepdir;
+  ms.moving    = moving;
+  motionlock.set(ms);
+  varEXIT_CRITICAL(&stepcountMux);
+#if defined(ESP8266)
+  interrupts();
+#endif
+}
+
+// update position and steps of a hardware step generator move from the pulse counter
+void DriverBoard::stepgenupdate(void)
+{
+#if defined(USESTEPGEN)
+  if ( hwmove == false )
+  {
+    return;
+  }
+  uint32_t done = stepgen->stepsdone();
+  varENTER_CRITICAL(&stepcountMux);
+  this->focuserposition = hwmv.position(done);
+  stepcount   = hwmv.stepsleft(done);
+  blstepcount = hwmv.backlashleft(done);
+  this->publishmotionstate();
+  varEXIT_CRITICAL(&stepcountMux);
+#endif
+}
+
+// take a consistent snapshot of the motion state without locking, retry if a writer was active
+void DriverBoard::getmotionstate(MotionState &ms)
+{
+  motionlock.read(ms);
 }
 
+// the live SGTHRS register, the stallguard setting scaled by initmove() for the motorspeed of the last
+// move (sg/2 medium, sg/6 fast), not the setting itself, which is mySetupData->get_stallguard()
 byte DriverBoard::getstallguard(void)
 {
   byte sgval = STALL_VALUE;                     // we must set it to something in case the next lines are not enabled
 #if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
   // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
-  sgval = mytmcstepper->SGTHRS();
+  sgval = tmcshadow.get(TMCREG_SGTHRS);
 #endif
   return sgval;
 }
 
+// send settings changed while stopped and read back the driver status, called by the motion loop only.
+// Writes made while moving wait for the end of the move, or the next initmove()
+void DriverBoard::tmcpoll(void)
+{
+#if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+  if ( (this->boardnum == PRO2ESP32TMC2225) || (this->boardnum == PRO2ESP32TMC2209) || (this->boardnum == PRO2ESP32TMC2209P) )
+  {
+    varENTER_CRITICAL(&stepcountMux);
+    uint32_t left = stepcount;
+    varEXIT_CRITICAL(&stepcountMux);
+    if ( left == 0 )
+    {
+      tmcshadow.flush();
+    }
+    tmcshadow.poll();
+  }
+#endif
+}
+
+bool DriverBoard::gettmcstatus(TmcStatus &ts)
+{
+#if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+  if ( (this->boardnum == PRO2ESP32TMC2225) || (this->boardnum == PRO2ESP32TMC2209) || (this->boardnum == PRO2ESP32TMC2209P) )
+  {
+    ts.drvstatus = tmcshadow.drvstatus();
+    ts.sgresult  = tmcshadow.sgresult();
+    ts.writes    = tmcshadow.writes;
+    ts.skipped   = tmcshadow.skipped;
+    ts.reads     = tmcshadow.reads;
+    ts.tpwmthrs  = tmcshadow.get(TMCREG_TPWMTHRS);
+    return true;
+  }
+#endif
+  return false;
+}
+
 void DriverBoard::setstallguard(byte newval)
 {
 #if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
   // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
-  mytmcstepper->SGTHRS(newval);
+  tmcshadow.set(TMCREG_SGTHRS, newval);
 #endif
   mySetupData->set_stallguard(newval);
 }
@@ -942,7 +1772,7 @@ void DriverBoard::settmc2209current(int newval)
 {
 #if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
   // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
-  mytmcstepper->rms_current(mySetupData->get_tmc2209current());     // Set driver current
+  tmcshadow.set(TMCREG_CURRENT, newval);                          // Set driver current
 #endif
   mySetupData->set_tmc2209current(newval);
 }
@@ -951,7 +1781,7 @@ void DriverBoard::settmc2225current(int newval)
 {
 #if (DRVBRD == PRO2ESP32TMC2225)
   // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
-  mytmcstepper->rms_current(mySetupData->get_tmc2225current());     // Set driver current
+  tmcshadow.set(TMCREG_CURRENT, newval);                          // Set driver current
 #endif
   mySetupData->set_tmc2225current(newval);
 }
@@ -13,6 +13,8 @@
 
 #include <myHalfStepperESP32.h>
 #include <myStepperESP32.h>
+#include "tmcshadow.h"
+#include "motionstate.h"                // MotionState
 
 #if (DRVBRD == PRO2ESP32TMC2225) || (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
 #define SERIAL_PORT2  Serial2       // TMC2225/TMC2209 HardwareSerial port
@@ -24,6 +26,36 @@
 #endif
 #endif
 
+// ======================================================================
+// TMC STATUS : shadow register counters and status read back in the background
+// ======================================================================
+struct TmcStatus
+{
+  uint32_t drvstatus;                             // DRV_STATUS
+  uint16_t sgresult;                              // SG_RESULT, tmc2209
+  uint32_t writes;                                // UART writes sent
+  uint32_t skipped;                               // writes skipped, value not changed
+  uint32_t reads;                                 // UART reads
+  uint32_t tpwmthrs;                              // SpreadCycle above this velocity, TSTEP, 0 = StealthChop only
+};
+
+#if defined(STEPTRACE)
+// ======================================================================
+// STEP TRACE : one entry per timer ISR step, see myBoards.cpp
+// ======================================================================
+#define TRACE_STEPMASK    0x00ffffffUL            // info, low 24 bits of stepcount after the step
+#define TRACE_OUT         0x01000000UL            // info, moving_out
+#define TRACE_BACKLASH    0x02000000UL            // info, backlash step, position not changed
+#define TRACE_HPSW        0x04000000UL            // info, home position switch ended the move
+#define TRACE_END         0x08000000UL            // info, end of move, no step taken
+
+struct StepTraceEntry
+{
+  uint32_t cycles;                                // cpu cycle counter when the ISR ran
+  uint32_t info;                                  // TRACE_ flags and stepcount
+};
+#endif
+
 // ======================================================================
 // DRIVER BOARD CLASS : DO NOT CHANGE
 // ======================================================================
@@ -32,30 +64,52 @@ class DriverBoard
   public:
     DriverBoard(unsigned long);                   // constructor
     ~DriverBoard(void);                           // destructor
-    void initmove(bool, unsigned long);           // prepare to move
+    void initmove(bool, unsigned long, unsigned long);  // prepare to move, direction, steps, backlash steps
     void movemotor(byte, bool);                   // move the motor
+    void stepmotor(bool);                         // step the motor in stepdir, used by timer ISR
     void halt(void);                              // halt the motor
     bool init_hpsw(void);                         // initialize home position switch
     void init_tmc2209(void);
     void init_tmc2225(void);
     bool hpsw_alert(void);                        // check for HPSW, and for TMC2209 stall guard or physical switch
     void end_move(void);                          // end a move
+    bool retargetmove(unsigned long);             // change target of a running move
+    bool nextphase(void);                         // start the fine phase after a coarse slew
+    void inithomemove(bool, unsigned long, byte, bool); // prepare a homing move that ends on the home position switch
+    bool hpsw_closed(void);                       // state of home position switch, any direction
+    void setmovespeed(byte);                      // motorspeed for the next move only
+
+    void publishmotionstate(void);                // publish position and steps, used by timer ISR
+    void tmcpoll(void);                           // TMC pending writes when stopped, status reads, once per loop()
 
     // getter
     unsigned long getposition(void);
-    byte getstallguard(void);
+    void getmotionstate(MotionState &);           // consistent snapshot of position, target and moving
+    byte getstallguard(void);                     // SGTHRS as written to the driver, scaled for the motorspeed of the last move
+    bool gettmcstatus(TmcStatus &);               // false if not a TMC board
     int getboardnumber(void);
 
     // setter
     void enablemotor(void);
     void releasemotor(void);
     void setposition(unsigned long);
+    void setmotionstate(unsigned long, byte);     // publish target and moving, once per loop()
     void setstepmode(int);
     void setstallguard(byte);
     void settmc2209current(int);
     void settmc2225current(int);
 
   private:
+    unsigned long initramp(unsigned long, byte);  // setup step interval ramp for a move, motorspeed of the move
+    unsigned long mininterval(void);              // shortest safe step interval of the board
+    unsigned long velocityinterval(void);         // step interval for the fast motorspeed
+    void initapproach(unsigned long, byte, unsigned long);  // setup the slow final approach of a move
+    void setmicrosteps(int);                      // write TMC microsteps, setting not changed
+    unsigned long coarseratio(void);              // fine steps per coarse step, 0 = no two phase moves
+    void tmcvelocity(unsigned long);              // TMC StealthChop/SpreadCycle and CoolStep thresholds
+    void stepgenupdate(void);                     // position from the hardware step generator pulse count
+    void hpsw_irq(void);                          // home position switch interrupt follows the hpsw setting
+
     HalfStepper*  myhstepper;
     Stepper*      mystepper;
 #if (DRVBRD == PRO2ESP32TMC2225 )
@@ -66,6 +120,9 @@ class DriverBoard
     // protection around mytmcstepper - it is not defined if not using tmc2209 or tmc2225
     TMC2209Stepper* mytmcstepper;
 #endif // DRVBRD == PRO2ESP32TMC2209  || DRVBRD == PRO2ESP32TMC2209P 
+#if (DRVBRD == PRO2ESP32TMC2225 || DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P )
+    TmcShadow     tmcshadow;                        // all mytmcstepper writes after init go through here
+#endif
 
     unsigned long focuserposition;                  // current focuser position
     int           inputPins[4];                     // input pins for driving stepper boards
@@ -218,21 +218,61 @@ pbTimer pbModTimer = {0, 0, 0};
 #error "Bluetooth Not enabled"
 #endif
 BluetoothSerial SerialBT;                     // define BT adapter to use
-String btline;                                // buffer for serial data
 #endif // BLUETOOTHMODE
 
 // Project specific includes - DO NOT CHANGE
-#if (CONTROLLERMODE == LOCALSERIAL || PROTOCOL == MOONLITE_PROTOCOL)
+#if (CONTROLLERMODE == LOCALSERIAL || CONTROLLERMODE == BLUETOOTHMODE || PROTOCOL == MOONLITE_PROTOCOL)
 #include "ESPQueue.h"                         // by Steven de Salas
-Queue queue(QUEUELENGTH);                     // receive serial queue of commands
-String serialline;                            // buffer for serial data
+Queue queue;                                  // receive serial queue of commands, filled in place by the reader
 #endif // #if defined(LOCALSERIAL)
 
 #if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
+#include "cmdline.h"                          // command assembly of the tcp clients
 IPAddress  ESP32IPAddress;
 //String     ServerLocalIP;
+// a client of the tcp/ip server, the command is assembled in line without blocking the loop,
+// replies are collected in out and sent with one write by flush() at the end of the loop pass
+struct TcpClient
+{
+  WiFiClient    client;
+  bool          active;                         // slot in use, stopped when the client disconnects
+  CmdLine       cmd;                            // command being received, see cmdline.h
+  char          out[TCPOUTBUFSIZE];             // replies not sent yet
+  size_t        outlen;
+  int           packetsreceived;
+  int           packetssent;
+
+  void flush(void)
+  {
+    if ( outlen > 0 )
+    {
+      client.write((const uint8_t *) out, outlen);
+      outlen = 0;
+    }
+  }
+
+  // queue a reply, a full buffer is sent first, a reply longer than the buffer is sent directly
+  void send(const char *str)
+  {
+    size_t slen = strlen(str);
+    if ( outlen + slen > TCPOUTBUFSIZE )
+    {
+      flush();
+    }
+    if ( slen > TCPOUTBUFSIZE )
+    {
+      client.write((const uint8_t *) str, slen);
+    }
+    else
+    {
+      memcpy(out + outlen, str, slen);
+      outlen += slen;
+    }
+  }
+};
 WiFiServer myserver(SERVERPORT);
-WiFiClient myclient;                          // only one client supported, multiple connections denied
+TcpClient  tcpclients[TCPCLIENTS];            // served round-robin by comms_loop()
+TcpClient  *tcpclient = &tcpclients[0];       // client of the command being processed, replies go here
 IPAddress  myIP;
 #endif // #if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
 
@@ -272,6 +312,28 @@ SetupData     *mySetupData;                 // focuser data
 unsigned long ftargetPosition;              // target position
 bool    displayfound;
 byte    isMoving;                           // is the motor currently moving
+byte    homestate = HOME_IDLE;              // progress of homing, HOME_IDLE .. HOME_FAILED
+bool    findhome;                           // request to find the home position switch
+byte    blcalstate = BLCAL_IDLE;            // progress of backlash calibration, BLCAL_IDLE .. BLCAL_FAILED
+byte    blcalrep;                           // backlash calibration, measurements done in each direction
+uint16_t blcalin[BLCALREPEATS];             // backlash calibration, measured steps in
+uint16_t blcalout[BLCALREPEATS];            // backlash calibration, measured steps out
+bool    blcalibrate;                        // request to calibrate backlash
+MoveSegment movequeue[MOVEQUEUESIZE];       // move queue, loaded by the motion task from MOTION_QUEUEADD
+byte    movequeuecount;                     // segments in the move queue
+byte    movequeueindex;                     // segments started, the running segment is movequeueindex - 1
+bool    movequeuestart;                     // request to run the move queue
+bool    movequeueload;                      // segments are accepted, after a MOTION_QUEUECLEAR while stopped
+bool    movequeuerun;                       // move queue is running
+MoveStats movestats;                        // moves, steps and extra steps since start
+TaskLoad motionload;                        // cpu load of the motion state machine
+TaskLoad commsload;                         // cpu load of tcp, serial, web, ascom and management servers
+#if defined(MOTIONTASK) && !defined(ESP8266)
+#define USEMOTIONTASK
+QueueHandle_t motionqueue;                  // MotionCommand from the comms task to the motion task
+TaskHandle_t  motiontask;
+TaskHandle_t  commstask;
+#endif
 char    ipStr[16] = "000.000.000.000";      // shared between BT mode and other modes
 
 long    rssi;                               // network signal strength
@@ -834,27 +896,250 @@ void software_Reboot(int Reboot_delay)
 {
   myoled->oledtextmsg("Reboot", -1, true, false);
   mySetupData->SaveNow();                       // save the focuser settings immediately
+#if ( (CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE) )
+  for ( int i = 0; i < TCPCLIENTS; i++ )
+  {
+    tcpclients[i].flush();                      // replies still queued by comms_loop()
+  }
+#endif
 
   // a reboot causes everything to reset, so code to stop services etc is not really needed
   delay(Reboot_delay);
   ESP.restart();
 }
 
-// move motor without updating position, used by sethomeposition
-void steppermotormove(byte ddir )               // direction moving_in, moving_out ^ reverse direction
+// move queue, segments are loaded while the focuser is stationary then run back to back by loop().
+// only the motion task changes the queue, comms code loads it with motion_queueadd()
+void movequeue_clear(void)
 {
-  // Basic assumption rule: If associated pin is -1 then cannot set enable
-  if ( mySetupData->get_inoutledstate() == 1)
+  movequeuecount = 0;
+  movequeueindex = 0;
+  movequeuestart = false;
+}
+
+// add a segment, target is limited to maxstep, returns false if the queue is full
+bool movequeue_add(unsigned long target, unsigned long dwell, byte mspeed)
+{
+  if ( movequeuecount >= MOVEQUEUESIZE )
   {
-    ( ddir == moving_in ) ? digitalWrite(mySetupData->get_brdinledpin(), 1) : digitalWrite(mySetupData->get_brdoutledpin(), 1);
+    return false;
   }
-  driverboard->movemotor(ddir, false);
-  if ( mySetupData->get_inoutledstate() == 1)
+  movequeue[movequeuecount].target = ( target > mySetupData->get_maxstep() ) ? mySetupData->get_maxstep() : target;
+  movequeue[movequeuecount].dwell  = dwell;
+  movequeue[movequeuecount].speed  = ( mspeed > 2 ) ? MOVESPEEDSETTING : mspeed;
+  movequeuecount++;
+  return true;
+}
+
+// apply a motion command, runs in the motion task
+void motion_apply(const MotionCommand &mc)
+{
+  long value = mc.value;
+  long pos;
+  switch ( mc.cmd )
+  {
+    case MOTION_MOVE:
+      ftargetPosition = (unsigned long) value;
+      break;
+    case MOTION_MOVEBY:
+      pos = (long) ftargetPosition + value;
+      pos = ( pos < 0 ) ? 0 : pos;
+      ftargetPosition = ( pos > (long) mySetupData->get_maxstep() ) ? mySetupData->get_maxstep() : (unsigned long) pos;
+      break;
+    case MOTION_HALT:
+      varENTER_CRITICAL(&halt_alertMux);
+      halt_alert = true;
+      varEXIT_CRITICAL(&halt_alertMux);
+      break;
+    case MOTION_SETPOSITION:
+      ftargetPosition = (unsigned long) value;
+      driverboard->setposition(ftargetPosition);
+      mySetupData->set_fposition(ftargetPosition);
+      break;
+    case MOTION_FINDHOME:
+      findhome = true;
+      break;
+    case MOTION_RUNQUEUE:
+      movequeuestart = ( movequeueload == true ) && ( movequeuecount != 0 );
+      movequeueload = false;
+      break;
+    case MOTION_BLCALIBRATE:
+      blcalibrate = true;
+      break;
+    case MOTION_DISPLAYOFF:
+      myoled->display_off();
+      break;
+    case MOTION_DISPLAYON:
+      myoled->display_on();
+      break;
+    case MOTION_STEPMODE:
+      driverboard->setstepmode((int) value);
+      break;
+    case MOTION_COILPOWER:
+      ( value == 1 ) ? driverboard->enablemotor() : driverboard->releasemotor();
+      break;
+    case MOTION_INITHPSW:
+      if ( driverboard->init_hpsw() == true )
+      {
+        DebugPrintln("hpsw init OK");
+      }
+      else
+      {
+        DebugPrintln("hpsw init NOK");
+      }
+      break;
+    case MOTION_STALLGUARD:
+      driverboard->setstallguard((byte) value);
+      break;
+    case MOTION_TMC2209CURRENT:
+      driverboard->settmc2209current((int) value);
+      break;
+    case MOTION_TMC2225CURRENT:
+      driverboard->settmc2225current((int) value);
+      break;
+    case MOTION_QUEUECLEAR:
+      // a move or a running queue may have started since the client checked, then the load is ignored
+      movequeueload = ( isMoving == 0 ) && ( movequeuerun == false ) && ( movequeuestart == false );
+      if ( movequeueload == true )
+      {
+        movequeue_clear();
+      }
+      break;
+    case MOTION_QUEUEADD:
+      if ( movequeueload == true )
+      {
+        movequeue_add(mc.seg.target, mc.seg.dwell, mc.seg.speed);
+      }
+      break;
+  }
+}
+
+// send a command to the motion state machine, with the motion task the command is queued, otherwise it is applied now
+void motion_send(const MotionCommand &mc)
+{
+#if defined(USEMOTIONTASK)
+  if ( xQueueSend(motionqueue, &mc, pdMS_TO_TICKS(10)) != pdTRUE )
+  {
+    DebugPrintln("motion queue full");
+  }
+#else
+  motion_apply(mc);
+#endif
+}
+
+// send a command to the motion state machine, this is the only way comms code changes the motion
+void motion_command(byte cmd, long value)
+{
+  MotionCommand mc = { cmd, value, { 0, 0, 0 } };
+  motion_send(mc);
+}
+
+// add a segment to the move queue being loaded, after motion_command(MOTION_QUEUECLEAR, 0).
+// motion_command(MOTION_RUNQUEUE, 0) runs the queue
+void motion_queueadd(unsigned long target, unsigned long dwell, byte mspeed)
+{
+  MotionCommand mc = { MOTION_QUEUEADD, 0, { target, dwell, mspeed } };
+  motion_send(mc);
+}
+
+// add busyus to the load of a task, the load is updated once per TASKLOADPERIOD
+void taskload_update(TaskLoad &tl, uint32_t busyus)
+{
+  tl.busy += busyus;
+  uint32_t elapsed = millis() - tl.start;
+  if ( elapsed >= TASKLOADPERIOD )
+  {
+    uint32_t load = tl.busy / (elapsed * 10);     // [uS] / [ms] / 10 = %
+    tl.load  = ( load > 100 ) ? 100 : load;
+    tl.busy  = 0;
+    tl.start = millis();
+  }
+}
+
+void comms_loop(void);
+void motion_loop(void);
+
+#if defined(USEMOTIONTASK)
+// motion task, runs the state machine on MOTIONTASKCORE
+void motiontaskloop(void *param)
+{
+  for (;;)
+  {
+    uint32_t tstart = micros();
+    motion_loop();
+    taskload_update(motionload, micros() - tstart);
+    vTaskDelay(1);
+  }
+}
+
+// comms task, runs the servers on COMMSTASKCORE next to the wifi stack
+void commstaskloop(void *param)
+{
+  for (;;)
+  {
+    uint32_t tstart = micros();
+    comms_loop();
+    taskload_update(commsload, micros() - tstart);
+    vTaskDelay(1);
+  }
+}
+#endif
+
+// focuser is at the home position switch, set position = 0
+void sethomeposition(String msg)
+{
+  ftargetPosition = 0;
+  driverboard->setposition(0);
+  mySetupData->set_fposition(0);
+  if ( mySetupData->get_showhpswmsg() == 1)       // check if display home position switch messages is enabled
   {
-    ( ddir == moving_in ) ? digitalWrite(mySetupData->get_brdinledpin(), 0) : digitalWrite(mySetupData->get_brdoutledpin(), 0);
+    if (mySetupData->get_displayenabled() == 1)
+    {
+      myoled->oledtextmsg(msg, -1, true, true);
+    }
   }
 }
 
+// final approach from one direction, returns the target of the next leg of a move from pos to target.
+// A move against the approach direction first goes overshoot steps past the target, limited to 0 and maxstep.
+unsigned long approach_leg(unsigned long target, unsigned long pos)
+{
+  unsigned long overshoot = mySetupData->get_overshoot();
+  unsigned long maxstep = mySetupData->get_maxstep();
+  if ( (mySetupData->get_approachdir() == APPROACH_OUT) && (target < pos) )
+  {
+    return ( target > overshoot ) ? target - overshoot : 0;
+  }
+  if ( (mySetupData->get_approachdir() == APPROACH_IN) && (target > pos) && (target < maxstep) )
+  {
+    return ( overshoot < maxstep - target ) ? target + overshoot : maxstep;
+  }
+  return target;
+}
+
+// median of the backlash calibration measurements, sorts them
+uint16_t blcal_median(uint16_t *steps)
+{
+  for ( int i = 1; i < BLCALREPEATS; i++ )
+  {
+    uint16_t s = steps[i];
+    int j = i - 1;
+    while ( (j >= 0) && (steps[j] > s) )
+    {
+      steps[j + 1] = steps[j];
+      j--;
+    }
+    steps[j + 1] = s;
+  }
+  return steps[BLCALREPEATS / 2];
+}
+
+// steps between two switch changes, limited to the backlash steps setting
+uint16_t blcal_steps(unsigned long steps)
+{
+  return ( steps > MAXBACKLASHSTEPS ) ? MAXBACKLASHSTEPS : (uint16_t) steps;
+}
+
 bool init_leds()
 {
   // Basic assumption rule: If associated pin is -1 then cannot set enable
@@ -977,9 +1262,56 @@ void start_tcpipserver()
 void stop_tcpipserver()
 {
   Setup_DebugPrintln("stop_tcipserver");
+  for ( int i = 0; i < TCPCLIENTS; i++ )
+  {
+    tcpclients[i].client.stop();
+    tcpclients[i].active = false;
+    tcpclients[i].cmd.reset();
+    tcpclients[i].outlen = 0;
+  }
   myserver.stop();
   tcpipserverstate = STOPPED;
 }
+
+// assemble a command from the bytes the client has sent so far, never waits for more bytes.
+// A partial command is kept for the next call, see CmdLine in cmdline.h. Reads at most CMDBUFSIZE
+// bytes per call. returns true when tc.cmd.line holds a complete command
+bool tcpclient_readline(TcpClient &tc)
+{
+  for ( int n = 0; (n < CMDBUFSIZE) && (tc.client.available() > 0); n++ )
+  {
+    int inChar = tc.client.read();
+    if ( inChar < 0 )
+    {
+      break;
+    }
+    int dropped = tc.cmd.dropped;
+    if ( tc.cmd.put((char) inChar) == true )
+    {
+      return true;
+    }
+    if ( tc.cmd.dropped != dropped )
+    {
+      DebugPrintln("tcp command too long");
+    }
+  }
+  return false;
+}
+
+// connected tcp clients and their packet counts, json array for the management server
+String tcpclients_json(void)
+{
+  String jsonstr = "[";
+  for ( int i = 0; i < TCPCLIENTS; i++ )
+  {
+    if ( tcpclients[i].active == true )
+    {
+      jsonstr += String(( jsonstr.length() > 1 ) ? "," : "") + "{ \"slot\":" + String(i) + ", \"ip\":\"" + tcpclients[i].client.remoteIP().toString() + "\", \"received\":"
+                 + String(tcpclients[i].packetsreceived) + ", \"sent\":" + String(tcpclients[i].packetssent) + ", \"dropped\":" + String(tcpclients[i].cmd.dropped) + " }";
+    }
+  }
+  return jsonstr + "]";
+}
 #endif // #if ((CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE))
 
 //_______________________________________________ setup()
@@ -994,7 +1326,6 @@ void setup()
 #else
   Serial.begin(SERIALPORTSPEED);                // assume myFP2ESP protocol
 #endif
-  serialline = "";
   clearSerialPort();
 #endif // #if (CONTROLLERMODE == LOCALSERIAL)
 
@@ -1017,7 +1348,6 @@ void setup()
 #if (CONTROLLERMODE == BLUETOOTHMODE)           // open Bluetooth port, set bluetooth device name
   Setup_DebugPrintln("Start Bluetooth");
   SerialBT.begin(BLUETOOTHNAME);                // Bluetooth device name
-  btline = "";
   clearbtPort();
 #endif // #if (CONTROLLERMODE == BLUETOOTHMODE)
 
@@ -1411,6 +1741,8 @@ void setup()
 
   heapmsg();
 
+  driverboard->setmotionstate(ftargetPosition, isMoving);  // first snapshot for comms, web and ascom
+
   Setup_DebugPrint("Position:");
   Setup_DebugPrintln(driverboard->getposition());
   Setup_DebugPrint("Target Position");
@@ -1428,7 +1760,14 @@ void setup()
   reboot = false;                                           // we have finished the reboot now
 
   cachepresets();
-  
+
+#if defined(USEMOTIONTASK)
+  // from here on loop() is not used, the motion state machine and the comms run in their own tasks
+  motionqueue = xQueueCreate(MOTIONQUEUESIZE, sizeof(MotionCommand));
+  xTaskCreatePinnedToCore(motiontaskloop, "motion", MOTIONTASKSTACK, NULL, 1, &motiontask, MOTIONTASKCORE);
+  xTaskCreatePinnedToCore(commstaskloop, "comms", COMMSTASKSTACK, NULL, 1, &commstask, COMMSTASKCORE);
+#endif
+
 #if defined(TIMESETUP)
   Setup_DebugPrint("setup(): ");
   Setup_DebugPrintln(millis());
@@ -1439,64 +1778,99 @@ void setup()
 
 void loop()
 {
-  static StateMachineStates MainStateMachine = State_Idle;
-  static uint32_t backlash_count = 0;
-  static bool     DirOfTravel = (bool) mySetupData->get_focuserdirection();
-  static uint32_t TimeStampDelayAfterMove = 0;
-  static uint32_t TimeStampPark = millis();
-  static bool     Parked = true;                  // focuser cannot be moving as it was just started
-  static bool     tms = false;                    // timersemaphore
-  static uint8_t  updatecount = 0;
-  static uint32_t steps = 0;
-
-  static connection_status ConnectionStatus = disconnected;
+#if defined(USEMOTIONTASK)
+  vTaskDelete(NULL);                              // motion and comms tasks were started by setup()
+#else
+  uint32_t tstart = micros();
+  comms_loop();
+  uint32_t tcomms = micros();
+  motion_loop();
+  taskload_update(commsload, tcomms - tstart);
+  taskload_update(motionload, micros() - tcomms);
+#endif
+} // end Loop()
 
-  int stepstaken = 0;
-  bool hpswstate = false;
+//_____________________ comms_loop()_____________________________________
 
-#if defined(TIMELOOP)
-  Setup_DebugPrint("loop(): ");
-  Setup_DebugPrintln(millis());
-#endif // #if defined(TIMELOOP)
+// tcp, bluetooth, serial, ota, web, ascom and management servers
+// changes to the motion are sent with motion_command(), state is read with driverboard->getmotionstate()
+void comms_loop(void)
+{
+  static connection_status ConnectionStatus = disconnected;
 
 #if ( (CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE) )
-  if (ConnectionStatus == disconnected)
+  static byte nextclient = 0;                     // round-robin, first client served in this pass
+  byte clientcount = 0;
+
+  // a new client takes a free slot, if there is none it is refused
+  WiFiClient newclient = myserver.available();
+  if (newclient)
   {
-    myclient = myserver.available();
-    if (myclient)
+    int slot = 0;
+    while ( (slot < TCPCLIENTS) && tcpclients[slot].client.connected() )
     {
-      if (myclient.connected())
-      {
-        DebugPrintln("tcp client connected");
-        ConnectionStatus = connected;
-        myoled->setConnectionStatus(ConnectionStatus);
-        // a client has connected, start oled display again
-        // oled = oled_on;
-      }
+      slot++;
+    }
+    if ( slot < TCPCLIENTS )
+    {
+      DebugPrint("tcp client connected: ");
+      DebugPrintln(slot);
+      tcpclients[slot].client.stop();
+      tcpclients[slot].client = newclient;
+      tcpclients[slot].client.setNoDelay(true);   // replies are already coalesced, do not wait for Nagle
+      tcpclients[slot].active = true;
+      tcpclients[slot].cmd.reset();
+      tcpclients[slot].cmd.dropped = 0;
+      tcpclients[slot].outlen = 0;
+      tcpclients[slot].packetsreceived = 0;
+      tcpclients[slot].packetssent = 0;
+    }
+    else
+    {
+      DebugPrintln("tcp client refused");
+      newclient.stop();
     }
   }
-  else
+
+  // each client gets up to TCPCMDSPERPASS pipelined commands per pass, their replies are sent with one write.
+  // Commands go through ESP_Communication() one at a time so motion changes from all clients are serialized
+  // by motion_command()
+  for ( int i = 0; i < TCPCLIENTS; i++ )
   {
-    // is data available from the client request
-    if (myclient.connected())
+    TcpClient &tc = tcpclients[(nextclient + i) % TCPCLIENTS];
+    if ( tc.client.connected() )
     {
-      if (myclient.available())
+      clientcount++;
+      for ( int n = 0; (n < TCPCMDSPERPASS) && (tcpclient_readline(tc) == true); n++ )
       {
+        tcpclient = &tc;
         ESP_Communication(); // Wifi communication
-        // client has sent a request, turn display on
-        // oled = olen_on;
       }
+      tc.flush();
     }
-    else
+    else if ( tc.active == true )
     {
-      DebugPrintln("tcp client disconnectd");
-      myclient.stop();
-      ConnectionStatus = disconnected;
-      myoled->setConnectionStatus(ConnectionStatus);
-      // client has disconnected, turn display off
-      myoled->display_off();
+      DebugPrintln("tcp client disconnected");
+      tc.client.stop();
+      tc.active = false;
+      tc.cmd.reset();
+      tc.outlen = 0;
     }
   }
+  nextclient = (nextclient + 1) % TCPCLIENTS;
+
+  if ( (clientcount != 0) && (ConnectionStatus == disconnected) )
+  {
+    ConnectionStatus = connected;
+    myoled->setConnectionStatus(ConnectionStatus);
+  }
+  else if ( (clientcount == 0) && (ConnectionStatus == connected) )
+  {
+    ConnectionStatus = disconnected;
+    myoled->setConnectionStatus(ConnectionStatus);
+    // last client has disconnected, turn display off, the display belongs to the motion task
+    motion_command(MOTION_DISPLAYOFF, 0);
+  }
 #endif // #if ( (CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE) )
 
 #if (CONTROLLERMODE == BLUETOOTHMODE)
@@ -1555,12 +1929,81 @@ void loop()
   }
 #endif
 #endif // #if ( (CONTROLLERMODE == ACCESSPOINT) || (CONTROLLERMODE == STATIONMODE) )
+} // end comms_loop()
+
+//_____________________ motion_loop()____________________________________
+
+// motion state machine, with push buttons, joystick, ir remote, display and temperature probe while idle
+void motion_loop(void)
+{
+  static StateMachineStates MainStateMachine = State_Idle;
+  static uint32_t backlash_count = 0;
+  static bool     DirOfTravel = (bool) mySetupData->get_focuserdirection();
+  static uint32_t TimeStampDelayAfterMove = 0;
+  static uint32_t TimeStampPark = millis();
+  static bool     Parked = true;                  // focuser cannot be moving as it was just started
+  static bool     tms = false;                    // timersemaphore
+  static uint8_t  updatecount = 0;
+  static uint32_t steps = 0;
+  static unsigned long MoveTarget = 0;            // target of the running move
+  static unsigned long LegTarget = 0;             // end of the running leg, past MoveTarget while overshooting
+  static bool     RestartMove = false;            // target changed while moving or overshooting, check position when move ends
+  static bool     RestartLeg = false;             // State_InitMove continues the running move, it is not a new move
+  static bool     ApproachLeg = false;            // the leg back from past the target, its steps are in movestats.overshoot
+  static bool     HomeReapproach = false;         // find home, back off is followed by a slow re-approach
+  static bool     HomeSlow = false;               // homing moves at slow speed
+  static unsigned long BlCalMark = 0;             // backlash calibration, position where the switch last changed
+
+  bool hpswstate = false;
+
+#if defined(TIMELOOP)
+  Setup_DebugPrint("loop(): ");
+  Setup_DebugPrintln(millis());
+#endif // #if defined(TIMELOOP)
+
+#if defined(USEMOTIONTASK)
+  MotionCommand mc;
+  while ( xQueueReceive(motionqueue, &mc, 0) == pdTRUE )
+  {
+    motion_apply(mc);
+  }
+#endif
+
+  driverboard->tmcpoll();                         // TMC driver writes and status reads, only from here
+
   //_____________________________MainMachine _____________________________
 
   switch (MainStateMachine)
   {
     case State_Idle:
-      if (driverboard->getposition() != ftargetPosition)
+      if ( findhome == true )
+      {
+        findhome = false;
+        isMoving = 1;
+        driverboard->enablemotor();
+        DebugPrintln("go FindHome");
+        MainStateMachine = State_FindHome;
+      }
+      else if ( blcalibrate == true )
+      {
+        blcalibrate = false;
+        isMoving = 1;
+        driverboard->enablemotor();
+        DebugPrintln("go BlCalStart");
+        MainStateMachine = State_BlCalStart;
+      }
+      else if ( movequeuestart == true )
+      {
+        movequeuestart = false;
+        movequeuerun = true;
+        movequeueindex = 0;
+        isMoving = 1;
+        driverboard->enablemotor();
+        DebugPrintln("go QueueDwell");
+        TimeStampDelayAfterMove = millis();
+        MainStateMachine = State_QueueDwell;
+      }
+      else if (driverboard->getposition() != ftargetPosition)
       {
         // we are going to move focuser, enable display
         // oled = oled_on;
@@ -1636,16 +2079,34 @@ void loop()
       break;
 
     case State_InitMove:
+      mySetupData->lock();                              // one set of settings for the move, see FocuserSetupData.h
+      ApproachLeg = ( RestartLeg == true ) && ( LegTarget != MoveTarget ) && ( driverboard->getposition() == LegTarget ) && ( ftargetPosition == MoveTarget );
+      if ( RestartLeg == false )
+      {
+        movestats.moves++;
+      }
+      RestartLeg = false;
       isMoving = 1;
       backlash_count = 0;
-      DirOfTravel = (ftargetPosition > driverboard->getposition()) ? moving_out : moving_in;
+      RestartMove = false;
+      HomeReapproach = false;
+      HomeSlow = false;
+      MoveTarget = ftargetPosition;
+      // a move against the final approach direction goes past the target first, the move restarts from there
+      LegTarget = approach_leg(ftargetPosition, driverboard->getposition());
+      RestartMove = ( LegTarget != ftargetPosition );
+      DirOfTravel = (LegTarget > driverboard->getposition()) ? moving_out : moving_in;
       driverboard->enablemotor();
       if (mySetupData->get_focuserdirection() != DirOfTravel)
       {
         mySetupData->set_focuserdirection(DirOfTravel);
         // move is in opposite direction, check for backlash enabled
         // get backlash settings
-        if ( DirOfTravel == moving_in)
+        if ( mySetupData->get_approachdir() != APPROACH_OFF )
+        {
+          backlash_count = 0;                           // the final approach takes up the slack, no backlash steps
+        }
+        else if ( DirOfTravel == moving_in)
         {
           if (mySetupData->get_backlash_in_enabled())
           {
@@ -1688,62 +2149,32 @@ void loop()
         */
       } // if (mySetupData->get_focuserdirection() != DirOfTravel)
 
-      // if target pos > current pos then steps = target pos - current pos
-      // if target pos < current pos then steps = current pos - target pos
-      steps = (ftargetPosition > driverboard->getposition()) ? ftargetPosition - driverboard->getposition() : driverboard->getposition() - ftargetPosition;
-
-      // Error - cannot combine backlash steps to steps because that alters position
-      // Backlash move SHOULD NOT alter focuser position as focuser is not actually moving
-      // backlash is taking up the slack in the stepper motor/focuser mechanism, so position is not actually changing
-      if ( backlash_count != 0 )
-      {
-        DebugPrintln("go backlash");
-        MainStateMachine = State_Backlash;
-      }
-      else
+      // if leg target > current pos then steps = leg target - current pos
+      // if leg target < current pos then steps = current pos - leg target
+      steps = (LegTarget > driverboard->getposition()) ? LegTarget - driverboard->getposition() : driverboard->getposition() - LegTarget;
+      movestats.backlash += backlash_count;
+      if ( ApproachLeg == false )
       {
-        // if target pos > current pos then steps = target pos - current pos
-        // if target pos < current pos then steps = current pos - target pos
-        driverboard->initmove(DirOfTravel, steps);
-        DebugPrint("Steps: ");
-        DebugPrintln(steps);
-        DebugPrintln("go moving");
-        MainStateMachine = State_Moving;
+        // the steps past the target and back are counted once, in overshoot
+        unsigned long past = (LegTarget > ftargetPosition) ? LegTarget - ftargetPosition : ftargetPosition - LegTarget;
+        movestats.steps += steps - past;
+        movestats.overshoot += 2 * past;
       }
-      break;
 
-    case State_Backlash:
-      // apply backlash
-      DebugPrint("Apply Backlash: Steps=");
-      DebugPrintln(backlash_count);
-      while ( backlash_count != 0 )
-      {
-        steppermotormove(DirOfTravel);                            // take 1 step and do not adjust position
-        delayMicroseconds(mySetupData->get_brdmsdelay());         // ensure delay between steps
-        backlash_count--;
-        if (driverboard->hpsw_alert() )                           // check if home position sensor activated?
-        {
-          DebugPrintln("HPS_alert() during backlash move");
-          varENTER_CRITICAL(&timerSemaphoreMux);
-          timerSemaphore = false;                                 // move finished
-          varEXIT_CRITICAL(&timerSemaphoreMux);
-          backlash_count = 0;                                     // drop out of while loop
-          MainStateMachine = State_Moving;                        // change state to State_Moving and handle HPSW
-        }
-      }
-      if ( MainStateMachine == State_Backlash )                   // finished backlash move, so now move motor #steps
-      {
-        DebugPrintln("Backlash done");
-        DebugPrint("Initiate motor move- steps: ");
-        DebugPrintln(steps);
-        driverboard->initmove(DirOfTravel, steps);
-        DebugPrintln("go moving");
-        MainStateMachine = State_Moving;
-      }
-      else
+      if ( movequeuerun == true )
       {
-        // MainStateMachine is State_Moving - timerSemaphore is false. is then caught by if(driverboard->hpsw_alert() ) and HPSW is processed
+        driverboard->setmovespeed(movequeue[movequeueindex - 1].speed);
       }
+      // backlash steps are passed separately, the step ISR takes them first without altering the focuser position
+      // backlash is taking up the slack in the stepper motor/focuser mechanism, so position is not actually changing
+      driverboard->initmove(DirOfTravel, steps, backlash_count);
+      DebugPrint("Steps: ");
+      DebugPrint(steps);
+      DebugPrint(" Backlash: ");
+      DebugPrintln(backlash_count);
+      mySetupData->unlock();
+      DebugPrintln("go moving");
+      MainStateMachine = State_Moving;
       break;
 
     //_______________________________State_Moving
@@ -1755,15 +2186,51 @@ void loop()
       varEXIT_CRITICAL(&timerSemaphoreMux);
       if ( tms == true )
       {
+        if ( driverboard->nextphase() == true )
+        {
+          DebugPrintln("Coarse slew completed");          // fine phase of a two phase move started
+          break;
+        }
         // move has completed, the driverboard keeps track of focuser position
         DebugPrintln("Move completed");
         driverboard->end_move();                          // disable interrupt timer that moves motor
-        TimeStampDelayAfterMove = millis();
-        DebugPrintln("go DelayAfterMove");
-        MainStateMachine = State_DelayAfterMove;
+        if ( (RestartMove == true) && (driverboard->getposition() != ftargetPosition) )
+        {
+          // target was changed during the move and could not be reached by the running move,
+          // or the move went past the target for the final approach. start a new move from here, State_InitMove handles direction change and backlash
+          DebugPrintln("go InitMove");
+          RestartLeg = true;
+          MainStateMachine = State_InitMove;
+        }
+        else if ( movequeuerun == true )
+        {
+          // segment done, dwell then run the next segment
+          TimeStampDelayAfterMove = millis();
+          DebugPrintln("go QueueDwell");
+          MainStateMachine = State_QueueDwell;
+        }
+        else
+        {
+          TimeStampDelayAfterMove = millis();
+          DebugPrintln("go DelayAfterMove");
+          MainStateMachine = State_DelayAfterMove;
+        }
       }
       else
       {
+        // target changed while moving, adjust the running move
+        if ( ftargetPosition != MoveTarget )
+        {
+          MoveTarget = ftargetPosition;
+          LegTarget = approach_leg(MoveTarget, driverboard->getposition());
+          RestartMove = true;
+          movequeuerun = false;                         // a new target from a client ends the move queue
+          if ( driverboard->retargetmove(LegTarget) == false )
+          {
+            DebugPrintln("retarget: stop then move");
+          }
+        }
+
         // timer semaphore is false. still moving, we need to check for halt
         if ( halt_alert || pbAbort() )                                 // halt_alert set by comms.h webserver.cpp
         {
@@ -1772,6 +2239,7 @@ void loop()
           halt_alert = false;                             // reset alert flag
           varEXIT_CRITICAL(&halt_alertMux);
           driverboard->end_move();                        // disable interrupt timer that moves motor
+          movequeuerun = false;
           ftargetPosition = driverboard->getposition();
           mySetupData->set_fposition(driverboard->getposition());
           // we no longer need to keep track of steps here or halt because driverboard updates position on every move
@@ -1783,6 +2251,7 @@ void loop()
         if ( driverboard->hpsw_alert() )                  // and we need to check if home position sensor activated?
         {
           driverboard->end_move();                        // disable interrupt timer that moves motor
+          movequeuerun = false;
           if (driverboard->getposition() > 0)
           {
             DebugPrintln("HP Sw=1, Pos not 0");
@@ -1856,55 +2325,303 @@ void loop()
           }
         }
         // HOME POSITION SWITCH IS CLOSED - Step out till switch opens then set position = 0
-        stepstaken = 0;                                   // Count number of steps to prevent going too far
+        // the step ISR stops the move when the switch opens, homesteps prevents going too far
         DebugPrintln("HP Sw=0, Mov out");
-        DirOfTravel = !DirOfTravel;                       // We were going in, now we need to reverse and go out
-        hpswstate = HPSWCLOSED;                           // We know we got here because switch was closed
-        while ( hpswstate == HPSWCLOSED )                 // while hpsw = closed = true = 1
+        homestate = HOME_BACKOFF;
+        DirOfTravel = moving_out;                         // We were going in, now we need to reverse and go out
+        driverboard->inithomemove(moving_out, mySetupData->get_homesteps(), HPSW_STOPOPEN, HomeSlow);
+        MainStateMachine = State_HomeBackOff;
+      }
+      else
+      {
+        MainStateMachine = State_DelayAfterMove;
+        TimeStampDelayAfterMove = millis();
+        DebugPrintln("go DelayAfterMove");
+      } //  if( mySetupData->get_homepositionswitch() == 1)
+      break;
+
+    case State_FindHome:                                  // seek in at speed till home position switch closes
+      DebugPrintln("State_FindHome");
+      if ( mySetupData->get_hpswitchenable() == 1)
+      {
+        RestartMove = false;
+        HomeReapproach = true;
+        HomeSlow = false;
+        homestate = HOME_SEEK;
+        DirOfTravel = moving_in;
+        mySetupData->set_focuserdirection(DirOfTravel);
+        // position may be wrong, allow homesteps beyond the current position
+        driverboard->inithomemove(moving_in, driverboard->getposition() + mySetupData->get_homesteps(), HPSW_STOPCLOSED, HomeSlow);
+        MainStateMachine = State_HomeSeek;
+      }
+      else
+      {
+        DebugPrintln("HP Sw disabled");
+        homestate = HOME_FAILED;
+        TimeStampDelayAfterMove = millis();
+        MainStateMachine = State_DelayAfterMove;
+      }
+      break;
+
+    case State_HomeSeek:                                  // homing moves run by the step ISR
+    case State_HomeBackOff:
+    case State_HomeClear:
+    case State_HomeApproach:
+      varENTER_CRITICAL(&timerSemaphoreMux);
+      tms = timerSemaphore;
+      varEXIT_CRITICAL(&timerSemaphoreMux);
+      if ( halt_alert || pbAbort() )
+      {
+        DebugPrintln("halt_alert");
+        varENTER_CRITICAL(&halt_alertMux);
+        halt_alert = false;
+        varEXIT_CRITICAL(&halt_alertMux);
+        driverboard->end_move();
+        homestate = HOME_FAILED;
+        ftargetPosition = driverboard->getposition();
+        mySetupData->set_fposition(driverboard->getposition());
+        TimeStampDelayAfterMove = millis();
+        MainStateMachine = State_DelayAfterMove;
+        break;
+      }
+      // the switch is also checked here, the ISR only signals the end of a move once it has taken a step
+      hpswstate = driverboard->hpsw_closed();
+      if ( (MainStateMachine == State_HomeSeek) || (MainStateMachine == State_HomeApproach) )
+      {
+        // moving in, wait till the switch closes
+        if ( hpswstate == HPSWCLOSED )
         {
-          if ( mySetupData->get_reversedirection() == 0 )
+          driverboard->end_move();
+          DebugPrintln("HP Sw=1");
+#if defined(USE_STALL_GUARD)
+          if ( mySetupData->get_brdnumber() == PRO2ESP32TMC2209 || mySetupData->get_brdnumber() == PRO2ESP32TMC2209P )
           {
-            steppermotormove(DirOfTravel);                // take 1 step
+            // stall guard, are home and no need to back off
+            DebugPrintln("Stall Guard: Pos = 0");
+            sethomeposition("HP Sw=1, Pos=0");
+            homestate = HOME_DONE;
+            TimeStampDelayAfterMove = millis();
+            MainStateMachine = State_DelayAfterMove;
+            break;
           }
-          else
+#endif // #if defined(USE_STALL_GUARD)
+          MainStateMachine = State_SetHomePosition;
+        }
+        else if ( tms == true )
+        {
+          driverboard->end_move();
+          DebugPrintln("HP Sw=0, seek err");
+          homestate = HOME_FAILED;
+          ftargetPosition = driverboard->getposition();
+          mySetupData->set_fposition(driverboard->getposition());
+          TimeStampDelayAfterMove = millis();
+          MainStateMachine = State_DelayAfterMove;
+        }
+      }
+      else if ( MainStateMachine == State_HomeBackOff )
+      {
+        // moving out, wait till the switch opens
+        if ( (hpswstate == HPSWOPEN) || (tms == true) )
+        {
+          driverboard->end_move();
+          DebugPrint("HP Sw, Mov out pos:");
+          DebugPrintln(driverboard->getposition());
+          if ( hpswstate == HPSWCLOSED )                  // this prevents the endless loop if the hpsw is not connected or is faulty
           {
-            steppermotormove(!DirOfTravel);
+            DebugPrintln("HP Sw=0, Mov out err");
+            homestate = HOME_FAILED;
+            sethomeposition("HP Sw=0, Mov out err");
           }
-
-          delayMicroseconds(mySetupData->get_brdmsdelay()); // Ensure delay between steps
-
-          stepstaken++;                                   // increment steps taken
-          if ( stepstaken > HOMESTEPS )                   // this prevents the endless loop if the hpsw is not connected or is faulty
+          else if ( HomeReapproach == true )
           {
-            DebugPrintln("HP Sw=0, Mov out err");
-            hpswstate = HPSWOPEN;
+            // find home, move clear of the switch then approach it again slowly
+            DebugPrintln("HP Sw=0, clear");
+            driverboard->initmove(moving_out, HOMECLEARSTEPS, 0);
+            MainStateMachine = State_HomeClear;
+            break;
           }
           else
           {
-            hpswstate = driverboard->hpsw_alert();        // hpsw_alert returns true if closed, false = open
+            DebugPrintln("HP Sw=0, Mov out ok");
+            homestate = HOME_DONE;
+            sethomeposition("HP Sw=0, Mov out ok");
           }
+          mySetupData->set_focuserdirection(DirOfTravel);   // set direction of last move
+          TimeStampDelayAfterMove = millis();
+          DebugPrintln("go DelayAfterMove");
+          MainStateMachine = State_DelayAfterMove;
         }
-        DebugPrint("HP Sw, Mov out steps:");
-        DebugPrintln(stepstaken);
-        DebugPrintln("HP Sw=0, Mov out ok");
-        ftargetPosition = 0;
-        driverboard->setposition(0);
-        mySetupData->set_fposition(0);
+      }
+      else // State_HomeClear
+      {
+        if ( tms == true )
+        {
+          driverboard->end_move();
+          DebugPrintln("HP Sw=0, approach");
+          HomeReapproach = false;
+          HomeSlow = true;
+          homestate = HOME_APPROACH;
+          DirOfTravel = moving_in;
+          driverboard->inithomemove(moving_in, HOMECLEARSTEPS + mySetupData->get_homesteps(), HPSW_STOPCLOSED, HomeSlow);
+          MainStateMachine = State_HomeApproach;
+        }
+      }
+      break;
 
-        mySetupData->set_focuserdirection(DirOfTravel);   // set direction of last move
+    case State_BlCalStart:                                // backlash calibration, seek in at speed till home position switch closes
+      DebugPrintln("State_BlCalStart");
+      RestartMove = false;
+      blcalrep = 0;
+      blcalstate = BLCAL_SEEK;
+      if ( mySetupData->get_hpswitchenable() == 1 )
+      {
+#if defined(USE_STALL_GUARD)
+        if ( mySetupData->get_brdnumber() == PRO2ESP32TMC2209 || mySetupData->get_brdnumber() == PRO2ESP32TMC2209P )
+        {
+          // stall guard signals the stall but not where the load is released, needs a physical switch
+          DebugPrintln("Stall Guard: no BL cal");
+          blcalstate = BLCAL_FAILED;
+        }
+#endif // #if defined(USE_STALL_GUARD)
+      }
+      else
+      {
+        DebugPrintln("HP Sw disabled");
+        blcalstate = BLCAL_FAILED;
+      }
+      if ( blcalstate == BLCAL_FAILED )
+      {
+        TimeStampDelayAfterMove = millis();
+        MainStateMachine = State_DelayAfterMove;
+        break;
+      }
+      DirOfTravel = moving_in;
+      driverboard->inithomemove(moving_in, driverboard->getposition() + mySetupData->get_homesteps(), HPSW_STOPCLOSED, false);
+      MainStateMachine = State_BlCalSeek;
+      break;
 
-        if ( mySetupData->get_showhpswmsg() == 1)         // check if display home position switch messages is enabled
+    case State_BlCalSeek:                                 // backlash calibration moves run by the step ISR
+    case State_BlCalOut:                                  // the steps from a switch close to the next open are backlash out,
+    case State_BlCalIn:                                   // from an open to the next close backlash in, both include the switch hysteresis
+      varENTER_CRITICAL(&timerSemaphoreMux);
+      tms = timerSemaphore;
+      varEXIT_CRITICAL(&timerSemaphoreMux);
+      hpswstate = driverboard->hpsw_closed();
+      if ( halt_alert || pbAbort() )
+      {
+        DebugPrintln("halt_alert");
+        varENTER_CRITICAL(&halt_alertMux);
+        halt_alert = false;
+        varEXIT_CRITICAL(&halt_alertMux);
+        blcalstate = BLCAL_FAILED;
+      }
+      else if ( MainStateMachine == State_BlCalOut )
+      {
+        // moving out, wait till the switch opens
+        if ( hpswstate == HPSWOPEN )
         {
-          if (mySetupData->get_displayenabled() == 1)
+          driverboard->end_move();
+          blcalout[blcalrep] = blcal_steps(driverboard->getposition() - BlCalMark);
+          BlCalMark = driverboard->getposition();
+          DebugPrint("BL cal out: ");
+          DebugPrintln(blcalout[blcalrep]);
+          blcalstate = BLCAL_IN;
+          DirOfTravel = moving_in;
+          driverboard->inithomemove(moving_in, mySetupData->get_homesteps(), HPSW_STOPCLOSED, true);
+          MainStateMachine = State_BlCalIn;
+        }
+        else if ( tms == true )
+        {
+          DebugPrintln("HP Sw=1, BL cal out err");
+          blcalstate = BLCAL_FAILED;
+        }
+      }
+      else
+      {
+        // moving in, wait till the switch closes
+        if ( hpswstate == HPSWCLOSED )
+        {
+          driverboard->end_move();
+          if ( MainStateMachine == State_BlCalIn )
           {
-            myoled->oledtextmsg("HP Sw=0, Mov out ok", -1, true, true);
+            blcalin[blcalrep] = blcal_steps(BlCalMark - driverboard->getposition());
+            DebugPrint("BL cal in: ");
+            DebugPrintln(blcalin[blcalrep]);
+            blcalrep++;
           }
+          BlCalMark = driverboard->getposition();
+          if ( blcalrep >= BLCALREPEATS )
+          {
+            // the median sorts the measurements, the progress page shows them in order
+            mySetupData->set_backlashsteps_in(blcal_median(blcalin));
+            mySetupData->set_backlashsteps_out(blcal_median(blcalout));
+            DebugPrintln("BL cal done");
+            blcalstate = BLCAL_DONE;
+            // the switch is closed, finish as find home does without the re-approach
+            HomeReapproach = false;
+            HomeSlow = true;
+            MainStateMachine = State_SetHomePosition;
+            break;
+          }
+          blcalstate = BLCAL_OUT;
+          DirOfTravel = moving_out;
+          driverboard->inithomemove(moving_out, mySetupData->get_homesteps(), HPSW_STOPOPEN, true);
+          MainStateMachine = State_BlCalOut;
         }
-      } //  if( mySetupData->get_homepositionswitch() == 1)
+        else if ( tms == true )
+        {
+          DebugPrintln("HP Sw=0, BL cal in err");
+          blcalstate = BLCAL_FAILED;
+        }
+      }
+      if ( blcalstate == BLCAL_FAILED )
+      {
+        driverboard->end_move();
+        ftargetPosition = driverboard->getposition();
+        mySetupData->set_fposition(driverboard->getposition());
+        TimeStampDelayAfterMove = millis();
+        MainStateMachine = State_DelayAfterMove;
+      }
+      break;
 
-      MainStateMachine = State_DelayAfterMove;
-      TimeStampDelayAfterMove = millis();
-      DebugPrintln("go DelayAfterMove");
+    case State_QueueDwell:                                // move queue, wait the dwell of the last segment then start the next one
+      if ( halt_alert || pbAbort() )
+      {
+        DebugPrintln("halt_alert");
+        varENTER_CRITICAL(&halt_alertMux);
+        halt_alert = false;
+        varEXIT_CRITICAL(&halt_alertMux);
+        movequeuerun = false;
+        ftargetPosition = driverboard->getposition();
+        TimeStampDelayAfterMove = millis();
+        MainStateMachine = State_DelayAfterMove;
+        break;
+      }
+      if ( TimeCheck(TimeStampDelayAfterMove, (movequeueindex == 0) ? 0 : movequeue[movequeueindex - 1].dwell) )
+      {
+        if ( movequeueindex < movequeuecount )
+        {
+          ftargetPosition = movequeue[movequeueindex].target;
+          movequeueindex++;
+          DebugPrint("Queue segment: ");
+          DebugPrintln(movequeueindex);
+          if ( driverboard->getposition() == ftargetPosition )
+          {
+            TimeStampDelayAfterMove = millis();           // already there, only dwell
+          }
+          else
+          {
+            MainStateMachine = State_InitMove;
+          }
+        }
+        else
+        {
+          DebugPrintln("Queue done");
+          movequeuerun = false;
+          TimeStampDelayAfterMove = millis();
+          MainStateMachine = State_DelayAfterMove;
+        }
+      }
       break;
 
     //_______________________________State_DelayAfterMove
@@ -1930,8 +2647,11 @@ void loop()
       break;
   }
 
+  // publish target and moving state, readers take position, target and isMoving from one snapshot
+  driverboard->setmotionstate(ftargetPosition, isMoving);
+
 #if defined(TIMELOOP)
   Setup_DebugPrint("loop(): ");
   Setup_DebugPrintln(millis());
 #endif
-} // end Loop()
+} // end motion_loop()
@@ -0,0 +1,263 @@
+// ======================================================================
+// ramp.h : myFP2ESP STEP INTERVAL RAMP
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+#ifndef ramp_h
+#define ramp_h
+
+#include <Arduino.h>
+#include "focuserconfig.h"                    // motorspeeds SLOW, MED
+#include "generalDefinitions.h"
+
+// ======================================================================
+// Step interval ramp
+// ======================================================================
+// Trapezoidal profile (accelerate, cruise, decelerate) based on AVR446, "Linear speed control of stepper motor".
+// Intervals are held in uS as 24.8 fixed point, so the ISR only needs integer math.
+// The float math for the start and cruise intervals is done in setup(), before the timer is started.
+// No hardware is used here, the caller loads the step timer with the intervals, see myBoards.cpp.
+#define RAMPSHIFT             8
+#define RAMP_NONE             0               // constant step rate
+#define RAMP_TRAPEZOID        1
+#define RAMP_SCURVE           2
+
+// S-curve (jerk limited) profile. Velocity over time follows v = 3t^2 - 2t^3, so acceleration
+// starts and ends at zero. The table holds the step interval multiplier [x256] relative to the cruise
+// interval at SCURVESIZE equal distance points along the ramp, and is computed by the compiler.
+#define SCURVESIZE            64
+#define SCURVEVMIN            (1.0 / 16.0)    // start speed as fraction of cruise speed, limits the first interval
+
+// normalized distance travelled at normalized time t
+constexpr double scurve_pos(double t)
+{
+  return 2.0 * t * t * t - t * t * t * t;
+}
+
+// normalized velocity at normalized time t
+constexpr double scurve_vel(double t)
+{
+  return 3.0 * t * t - 2.0 * t * t * t;
+}
+
+// find the time at which distance x is reached, by bisection
+constexpr double scurve_time(double x, double lo, double hi, int n)
+{
+  return ( n == 0 ) ? (lo + hi) / 2.0 :
+         ( scurve_pos((lo + hi) / 2.0) < x ) ? scurve_time(x, (lo + hi) / 2.0, hi, n - 1) : scurve_time(x, lo, (lo + hi) / 2.0, n - 1);
+}
+
+constexpr uint16_t scurve_mult(int i)
+{
+  return (uint16_t) (256.0 / (SCURVEVMIN + (1.0 - SCURVEVMIN) * scurve_vel(scurve_time((double) i / SCURVESIZE, 0.0, 1.0, 24))) + 0.5);
+}
+
+#if defined(ESP8266)
+constexpr uint16_t scurve_table[SCURVESIZE + 1] =
+#else
+DRAM_ATTR constexpr uint16_t scurve_table[SCURVESIZE + 1] =
+#endif
+{
+  scurve_mult(0), scurve_mult(1), scurve_mult(2), scurve_mult(3), scurve_mult(4), scurve_mult(5), scurve_mult(6), scurve_mult(7),
+  scurve_mult(8), scurve_mult(9), scurve_mult(10), scurve_mult(11), scurve_mult(12), scurve_mult(13), scurve_mult(14), scurve_mult(15),
+  scurve_mult(16), scurve_mult(17), scurve_mult(18), scurve_mult(19), scurve_mult(20), scurve_mult(21), scurve_mult(22), scurve_mult(23),
+  scurve_mult(24), scurve_mult(25), scurve_mult(26), scurve_mult(27), scurve_mult(28), scurve_mult(29), scurve_mult(30), scurve_mult(31),
+  scurve_mult(32), scurve_mult(33), scurve_mult(34), scurve_mult(35), scurve_mult(36), scurve_mult(37), scurve_mult(38), scurve_mult(39),
+  scurve_mult(40), scurve_mult(41), scurve_mult(42), scurve_mult(43), scurve_mult(44), scurve_mult(45), scurve_mult(46), scurve_mult(47),
+  scurve_mult(48), scurve_mult(49), scurve_mult(50), scurve_mult(51), scurve_mult(52), scurve_mult(53), scurve_mult(54), scurve_mult(55),
+  scurve_mult(56), scurve_mult(57), scurve_mult(58), scurve_mult(59), scurve_mult(60), scurve_mult(61), scurve_mult(62), scurve_mult(63),
+  scurve_mult(64)
+};
+
+// cruise step interval [uS] of a move. curspd is the interval for the motorspeed of the move, used when
+// maxspd [steps/s] is 0. Else the interval comes from maxspd, never faster than cfast, slowed down for mspeed
+inline float ramp_cruise(unsigned long curspd, unsigned long maxspd, unsigned long cfast, byte mspeed)
+{
+  float cmin = curspd;
+  if ( maxspd != 0 )
+  {
+    cmin = 1000000.0 / maxspd;                  // cruise interval from max speed in steps/s
+    cmin = ( cmin < cfast ) ? cfast : cmin;     // never faster than the board allows
+    switch ( mspeed )
+    {
+      case SLOW: // slow, 1/3rd the speed
+        cmin *= 3;
+        break;
+      case MED: // med, 1/2 the speed
+        cmin *= 2;
+        break;
+    }
+  }
+  return ( cmin < 1.0 ) ? 1.0 : cmin;
+}
+
+// ======================================================================
+// STEP RAMP : intervals of a move, one call of next() after each step
+// ======================================================================
+class StepRamp
+{
+  public:
+    // setup the ramp for a move, cmin is the cruise interval [uS], accel in steps/s/s, 0 = no ramp
+    // returns the interval to use for the first step
+    uint32_t setup(float cmin, unsigned long accel, byte profile)
+    {
+      float c0 = cmin;
+      if ( accel != 0 )
+      {
+        c0 = 0.676 * sqrt(2.0 / accel) * 1000000.0; // first step interval, AVR446 eq. 15
+        c0 = ( c0 > RAMPMAXINTERVAL ) ? RAMPMAXINTERVAL : c0;
+      }
+
+      n    = 0;
+      mode = ( c0 > cmin ) ? RAMP_TRAPEZOID : RAMP_NONE;
+      if ( mode == RAMP_NONE )
+      {
+        c0 = cmin;
+      }
+      else if ( profile == PROFILE_SCURVE )
+      {
+        // same average acceleration as the trapezoid, ramp length is v^2 / 2a
+        float vmax = 1000000.0 / cmin;
+        float rsteps = (vmax * vmax) / (2.0 * accel);
+        rsteps = ( rsteps < 1.0 ) ? 1.0 : rsteps;
+        rsteps = ( rsteps > ((unsigned long) SCURVESIZE << 16) ) ? ((unsigned long) SCURVESIZE << 16) : rsteps;
+        scurve_steps    = (uint32_t) rsteps;
+        scurve_phaseinc = ((uint32_t) SCURVESIZE << 16) / scurve_steps;
+        scurve_cruise   = (uint32_t) cmin;
+        mode            = RAMP_SCURVE;
+        c0 = this->scurve_interval(0);
+      }
+      mininterval = (uint32_t) cmin << RAMPSHIFT;
+      interval    = (uint32_t) c0 << RAMPSHIFT;
+
+      // the ramp decelerates to the approach speed, at approach_n steps from the start of the ramp. An approach
+      // slower than c0 starts after a full stop of the ramp
+      approach_n = 0;
+      if ( (mode != RAMP_NONE) && (approach_steps != 0) )
+      {
+        approach_interval = ( approach_interval < (uint32_t) cmin ) ? (uint32_t) cmin : approach_interval;
+        if ( approach_interval < c0 )
+        {
+          if ( mode == RAMP_SCURVE )
+          {
+            // first table point at or faster than the approach, then the first ramp step that reaches it
+            uint32_t i = 0;
+            while ( this->scurve_interval(i) > approach_interval )
+            {
+              i++;
+            }
+            approach_n = ((i << 16) + scurve_phaseinc - 1) / scurve_phaseinc;
+          }
+          else
+          {
+            float va = 1000000.0 / approach_interval;   // ramp length to the approach speed is v^2 / 2a
+            approach_n = (uint32_t) ((va * va) / (2.0 * accel));
+          }
+        }
+      }
+      return (uint32_t) c0;
+    }
+
+    // steps needed to stop from the current speed
+    uint32_t stopsteps(void)
+    {
+      return ( mode == RAMP_NONE ) ? 0 : n;
+    }
+
+    // called by the ISR after each step, left is the number of steps still to take.
+    // returns the interval [uS] to the next step, 0 if the interval does not change
+    inline uint32_t next(uint32_t left) __attribute__((always_inline))
+    {
+      uint32_t endn = 0;                        // ramp step the deceleration ends at
+      if ( approach_steps != 0 )
+      {
+        // switch once to the approach speed, when the ramp is down to it. A retarget can leave less than
+        // the ramp needs, then the ramp keeps decelerating into the approach
+        if ( (left <= approach_steps) && ((mode == RAMP_NONE) || (n <= approach_n)) )
+        {
+          approach_steps = 0;
+          mode = RAMP_NONE;
+          return approach_interval;
+        }
+        left = ( left > approach_steps ) ? left - approach_steps : 0;  // end of the ramp is the start of the approach
+        endn = approach_n;
+      }
+      if ( mode == RAMP_NONE )
+      {
+        return 0;
+      }
+      if ( mode == RAMP_SCURVE )
+      {
+        if ( left + endn <= n )                 // decelerate
+        {
+          if ( n == 0 )
+          {
+            return 0;
+          }
+          n--;
+        }
+        else if ( n < scurve_steps )            // accelerate
+        {
+          n++;
+        }
+        else
+        {
+          return 0;                             // cruise
+        }
+        return this->scurve_interval((n * scurve_phaseinc) >> 16);
+      }
+      uint32_t c = interval;
+      if ( left + endn <= n )                   // remaining steps equal the stopping distance, so decelerate
+      {
+        if ( n == 0 )
+        {
+          return 0;
+        }
+        c += (2 * c) / (4 * n - 1);
+        n--;
+        if ( (approach_steps != 0) && (c > (approach_interval << RAMPSHIFT)) )
+        {
+          c = approach_interval << RAMPSHIFT;   // never slower than the approach that follows
+        }
+      }
+      else if ( c > mininterval )               // accelerate
+      {
+        n++;
+        c -= (2 * c) / (4 * n + 1);
+        c = ( c < mininterval ) ? mininterval : c;
+      }
+      else
+      {
+        return 0;                               // cruise, interval does not change
+      }
+      interval = c;
+      return c >> RAMPSHIFT;
+    }
+
+    volatile uint32_t interval;                 // current step interval [uS << RAMPSHIFT]
+    volatile uint32_t mininterval;              // cruise step interval [uS << RAMPSHIFT]
+    volatile uint32_t n;                        // steps taken on the ramp, which is also the steps needed to stop
+    volatile byte     mode;                     // RAMP_NONE, RAMP_TRAPEZOID or RAMP_SCURVE
+
+    // Final approach (motorspeed change). The last approach_steps of a move run at the slow interval. A ramp
+    // decelerates to the approach interval at the start of the approach, never below it, so the speed does not
+    // jump up or down between them. setup() keeps the approach no faster than cruise.
+    volatile uint32_t approach_steps;           // steps left when the approach starts, 0 = no approach
+    volatile uint32_t approach_interval;        // approach step interval [uS]
+    volatile uint32_t approach_n;               // ramp step at the approach speed, 0 if slower than the ramp start
+
+    volatile uint32_t scurve_steps;             // length of the ramp in steps
+    volatile uint32_t scurve_phaseinc;          // table index increment per ramp step [<< 16]
+    volatile uint32_t scurve_cruise;            // cruise step interval [uS]
+
+  private:
+    // step interval [uS] at table point i. The multiplier is up to 16 x 256, so the product is 64 bit,
+    // a cruise above 1048575 uS would overflow 32 bits
+    inline uint32_t scurve_interval(uint32_t i) __attribute__((always_inline))
+    {
+      return (uint32_t) (((uint64_t) scurve_cruise * scurve_table[i]) >> 8);
+    }
+};
+
+#endif // #ifndef ramp_h
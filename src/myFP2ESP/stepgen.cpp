@@ -0,0 +1,236 @@
+// ======================================================================
+// stepgen.cpp : myFP2ESP HARDWARE STEP PULSE GENERATOR
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+// ======================================================================
+// Includes
+// ======================================================================
+#include <Arduino.h>
+#include "focuserconfig.h"
+#include "generalDefinitions.h"
+#include "stepgen.h"
+
+#if !defined(ESP8266) && defined(HWSTEPGEN)
+#include "driver/rmt.h"
+#include "driver/pcnt.h"
+#include "soc/io_mux_reg.h"                   // PIN_INPUT_ENABLE
+
+// ======================================================================
+// Data
+// ======================================================================
+#define STEPGEN_RMTCHANNEL    RMT_CHANNEL_0
+#define STEPGEN_PCNTUNIT      PCNT_UNIT_0
+#define STEPGEN_SOURCESIZE    0xffffffffUL    // the translator ends the transmission, not the source size
+
+portMUX_TYPE stepgenMux = portMUX_INITIALIZER_UNLOCKED;
+
+uint8_t sg_steppin;
+void (*sg_done)(void);                        // called when the last pulse is out
+rmt_item32_t sg_pulse;                        // one step, high for STEPGEN_PULSE then low for the rest of the interval
+const uint8_t sg_source = 0;                  // dummy source for rmt_write_sample(), never read
+volatile uint32_t sg_total;                   // pulses of the move
+volatile uint32_t sg_committed;               // pulses handed to the RMT memory, sent or not
+volatile bool sg_ended;                       // translator has ended the transmission
+volatile bool sg_busy;
+volatile uint32_t sg_wraps;                   // pulse counter wraps at STEPGEN_PCNTLIMIT
+volatile uint32_t sg_lastdone;
+
+// ======================================================================
+// Interrupt handlers
+// ======================================================================
+// RMT translator, called by the RMT driver when there is room in the RMT memory. The source is not
+// read, the pulses are taken from sg_total. Returning fewer items than wanted, and consuming the whole
+// source, ends the transmission after the last pulse.
+static void IRAM_ATTR sg_translate(const void *src, rmt_item32_t *dest, size_t src_size, size_t wanted_num, size_t *translated_size, size_t *item_num)
+{
+  portENTER_CRITICAL(&stepgenMux);
+  uint32_t left = sg_total - sg_committed;
+  size_t n = ( left < wanted_num ) ? left : wanted_num;
+  sg_committed += n;
+  sg_ended = ( n < wanted_num );
+  portEXIT_CRITICAL(&stepgenMux);
+  for ( size_t i = 0; i < n; i++ )
+  {
+    dest[i].val = sg_pulse.val;
+  }
+  *item_num = n;
+  *translated_size = ( n < wanted_num ) ? src_size : n;
+}
+
+// RMT transmission done
+static void IRAM_ATTR sg_txend(rmt_channel_t channel, void *arg)
+{
+  if ( channel == STEPGEN_RMTCHANNEL )
+  {
+    sg_busy = false;
+    if ( sg_done != NULL )
+    {
+      sg_done();
+    }
+  }
+}
+
+// pulse counter reached STEPGEN_PCNTLIMIT and restarted at 0
+static void IRAM_ATTR sg_wrap(void *arg)
+{
+  sg_wraps = sg_wraps + 1;
+}
+
+// ======================================================================
+// RmtStepGenerator
+// ======================================================================
+// undo a part done begin(), the step pin goes back to a gpio output for the timer ISR
+static bool sg_fail(const char *msg, bool pcntisr, bool rmtdriver)
+{
+  Board_DebugPrintln(msg);
+  pcnt_counter_pause(STEPGEN_PCNTUNIT);
+  if ( pcntisr )
+  {
+    pcnt_isr_handler_remove(STEPGEN_PCNTUNIT);
+  }
+  if ( rmtdriver )
+  {
+    rmt_driver_uninstall(STEPGEN_RMTCHANNEL);
+  }
+  pinMode(sg_steppin, OUTPUT);
+  digitalWrite(sg_steppin, 0);
+  return false;
+}
+
+// setup the RMT channel and the pulse counter, the step pin stays a gpio output till a move starts
+// returns false if any part of the hardware cannot be set up, the caller then uses the timer ISR
+bool RmtStepGenerator::begin(uint8_t steppin, void (*done)(void))
+{
+  sg_steppin = steppin;
+  sg_done    = done;
+  sg_busy    = false;
+
+  pcnt_config_t pcfg = {};
+  pcfg.pulse_gpio_num = steppin;
+  pcfg.ctrl_gpio_num  = PCNT_PIN_NOT_USED;
+  pcfg.channel        = PCNT_CHANNEL_0;
+  pcfg.unit           = STEPGEN_PCNTUNIT;
+  pcfg.pos_mode       = PCNT_COUNT_INC;             // count rising edges
+  pcfg.neg_mode       = PCNT_COUNT_DIS;
+  pcfg.lctrl_mode     = PCNT_MODE_KEEP;
+  pcfg.hctrl_mode     = PCNT_MODE_KEEP;
+  pcfg.counter_h_lim  = STEPGEN_PCNTLIMIT;
+  pcfg.counter_l_lim  = 0;
+  if ( pcnt_unit_config(&pcfg) != ESP_OK )
+  {
+    return sg_fail("stepgen: pcnt config failed", false, false);
+  }
+  esp_err_t err = pcnt_isr_service_install(0);    // already installed by other code is fine
+  if ( (pcnt_event_enable(STEPGEN_PCNTUNIT, PCNT_EVT_H_LIM) != ESP_OK) || ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) )
+  {
+    return sg_fail("stepgen: pcnt isr service failed", false, false);
+  }
+  if ( pcnt_isr_handler_add(STEPGEN_PCNTUNIT, sg_wrap, NULL) != ESP_OK )
+  {
+    return sg_fail("stepgen: pcnt isr handler failed", false, false);
+  }
+  pcnt_counter_pause(STEPGEN_PCNTUNIT);
+  pcnt_counter_clear(STEPGEN_PCNTUNIT);
+
+  rmt_config_t rcfg = {};
+  rcfg.rmt_mode                  = RMT_MODE_TX;
+  rcfg.channel                   = STEPGEN_RMTCHANNEL;
+  rcfg.gpio_num                  = (gpio_num_t) steppin;
+  rcfg.mem_block_num             = 1;
+  rcfg.clk_div                   = 80;              // 1uS ticks
+  rcfg.tx_config.loop_en         = false;
+  rcfg.tx_config.carrier_en      = false;
+  rcfg.tx_config.idle_output_en  = true;
+  rcfg.tx_config.idle_level      = RMT_IDLE_LEVEL_LOW;
+  if ( rmt_config(&rcfg) != ESP_OK )
+  {
+    return sg_fail("stepgen: rmt config failed", true, false);
+  }
+  if ( rmt_driver_install(STEPGEN_RMTCHANNEL, 0, 0) != ESP_OK )
+  {
+    return sg_fail("stepgen: rmt driver install failed", true, false);
+  }
+  if ( rmt_translator_init(STEPGEN_RMTCHANNEL, sg_translate) != ESP_OK )
+  {
+    return sg_fail("stepgen: rmt translator failed", true, true);
+  }
+  rmt_register_tx_end_callback(sg_txend, NULL);     // returns the previous callback, cannot fail
+
+  this->end();                                      // step pin back to gpio till the first move
+  return true;
+}
+
+// send steps pulses at intervalus, STEPGEN_MININTERVAL <= intervalus <= STEPGEN_MAXINTERVAL
+void RmtStepGenerator::start(uint32_t steps, uint32_t intervalus)
+{
+  sg_pulse.level0    = 1;
+  sg_pulse.duration0 = STEPGEN_PULSE;
+  sg_pulse.level1    = 0;
+  sg_pulse.duration1 = intervalus - STEPGEN_PULSE;
+
+  pcnt_counter_pause(STEPGEN_PCNTUNIT);
+  pcnt_counter_clear(STEPGEN_PCNTUNIT);
+  portENTER_CRITICAL(&stepgenMux);
+  sg_total     = steps;
+  sg_committed = 0;
+  sg_ended     = false;
+  sg_wraps     = 0;
+  sg_lastdone  = 0;
+  sg_busy      = true;
+  portEXIT_CRITICAL(&stepgenMux);
+
+  rmt_set_pin(STEPGEN_RMTCHANNEL, RMT_MODE_TX, (gpio_num_t) sg_steppin);
+  PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[sg_steppin]);   // the pulse counter reads the pin back
+  pcnt_counter_resume(STEPGEN_PCNTUNIT);
+  rmt_write_sample(STEPGEN_RMTCHANNEL, &sg_source, STEPGEN_SOURCESIZE, false);
+}
+
+// change the pulses of the running move. If more than steps pulses are already in the RMT memory,
+// or the transmission is ending, the move ends after the committed pulses.
+// returns the pulses the move now ends with
+uint32_t RmtStepGenerator::settotal(uint32_t steps)
+{
+  portENTER_CRITICAL(&stepgenMux);
+  if ( sg_ended || (steps < sg_committed) )
+  {
+    steps = sg_committed;
+  }
+  sg_total = steps;
+  portEXIT_CRITICAL(&stepgenMux);
+  return steps;
+}
+
+// pulses counted since start. A wrap whose interrupt is still pending reads low, so the count is
+// never allowed to go back, and it can never be more than the pulses committed.
+uint32_t RmtStepGenerator::stepsdone(void)
+{
+  uint32_t wraps;
+  int16_t  count;
+  do
+  {
+    wraps = sg_wraps;
+    pcnt_get_counter_value(STEPGEN_PCNTUNIT, &count);
+  } while ( wraps != sg_wraps );
+  uint32_t done = wraps * STEPGEN_PCNTLIMIT + (uint16_t) count;
+  done = ( done < sg_lastdone ) ? sg_lastdone : done;
+  done = ( done > sg_committed ) ? sg_committed : done;
+  sg_lastdone = done;
+  return done;
+}
+
+bool RmtStepGenerator::busy(void)
+{
+  return sg_busy;
+}
+
+// route the step pin back to the gpio output register, used by the timer ISR path
+void RmtStepGenerator::end(void)
+{
+  pcnt_counter_pause(STEPGEN_PCNTUNIT);
+  pinMode(sg_steppin, OUTPUT);
+  digitalWrite(sg_steppin, 0);
+}
+
+#endif // #if !defined(ESP8266) && defined(HWSTEPGEN)
@@ -0,0 +1,106 @@
+// ======================================================================
+// stepgen.h : myFP2ESP HARDWARE STEP PULSE GENERATOR
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+#ifndef stepgen_h
+#define stepgen_h
+
+#include <Arduino.h>
+#include "focuserconfig.h"
+#include "generalDefinitions.h"
+
+// ======================================================================
+// STEP GENERATOR INTERFACE
+// ======================================================================
+// Sends a counted train of step pulses on the step pin without the timer ISR.
+// DriverBoard only uses this interface, so the hardware can be replaced by a fake.
+class StepGenerator
+{
+  public:
+    virtual bool begin(uint8_t, void (*)(void)) = 0;  // step pin, done callback (called from an ISR), false if no hardware
+    virtual void start(uint32_t, uint32_t) = 0;       // send pulses, interval [uS]
+    virtual uint32_t settotal(uint32_t) = 0;          // change pulses of the running move, returns the pulses it now ends with
+    virtual uint32_t stepsdone(void) = 0;             // pulses seen on the step pin since start
+    virtual bool busy(void) = 0;                      // pulses still to send
+    virtual void end(void) = 0;                       // give the step pin back to gpio after a move
+};
+
+// ======================================================================
+// STEP GENERATOR MOVE : focuser position and steps left from the pulses sent
+// ======================================================================
+// The backlash pulses are sent first and do not move the focuser, each other pulse moves it by weight.
+// No hardware is used here, DriverBoard feeds it stepsdone() of the running move.
+class StepGenMove
+{
+  public:
+    // a move of backlash + steps pulses starts at position in direction dir
+    void start(unsigned long position, uint32_t backlash, uint32_t steps, bool dir, uint32_t weight)
+    {
+      startpos   = position;
+      blsteps    = backlash;
+      total      = backlash + steps;
+      stepdir    = dir;
+      stepweight = weight;
+    }
+
+    // focuser position after done pulses
+    unsigned long position(uint32_t done) const
+    {
+      uint32_t moved = ( done > blsteps ) ? (done - blsteps) * stepweight : 0;
+      return ( stepdir == moving_in ) ? startpos - moved : startpos + moved;
+    }
+
+    // pulses still to send after done pulses
+    uint32_t stepsleft(uint32_t done) const
+    {
+      return ( total > done ) ? total - done : 0;
+    }
+
+    // backlash pulses still to send after done pulses
+    uint32_t backlashleft(uint32_t done) const
+    {
+      return ( blsteps > done ) ? blsteps - done : 0;
+    }
+
+    // pulses the move needs to end at target, after done pulses. 0 if target is behind the focuser,
+    // or the focuser is already there, or it is not a whole number of pulses away: stop the move
+    uint32_t retarget(uint32_t done, unsigned long target) const
+    {
+      unsigned long pos = this->position(done);
+      bool mdir = ( target > pos ) ? moving_out : moving_in;
+      unsigned long steps = ( target > pos ) ? target - pos : pos - target;
+      if ( (steps == 0) || (mdir != stepdir) || ((steps % stepweight) != 0) )
+      {
+        return 0;
+      }
+      return done + this->backlashleft(done) + steps / stepweight;
+    }
+
+    uint32_t total;                                   // pulses of the move, backlash included
+
+  private:
+    unsigned long startpos;                           // focuser position at the start of the move
+    uint32_t blsteps;                                 // backlash pulses of the move, sent first
+    bool stepdir;
+    uint32_t stepweight;                              // fine steps per pulse
+};
+
+#if !defined(ESP8266) && defined(HWSTEPGEN)
+// ======================================================================
+// RMT STEP GENERATOR : RMT sends the pulses, PCNT counts them on the same pin
+// ======================================================================
+class RmtStepGenerator : public StepGenerator
+{
+  public:
+    bool begin(uint8_t, void (*)(void));
+    void start(uint32_t, uint32_t);
+    uint32_t settotal(uint32_t);
+    uint32_t stepsdone(void);
+    bool busy(void);
+    void end(void);
+};
+#endif // #if !defined(ESP8266) && defined(HWSTEPGEN)
+
+#endif // #ifndef stepgen_h
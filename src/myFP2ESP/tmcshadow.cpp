@@ -0,0 +1,145 @@
+// ======================================================================
+// tmcshadow.cpp : myFP2ESP TMC DRIVER SHADOW REGISTERS
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+// ======================================================================
+// Includes
+// ======================================================================
+#include <Arduino.h>
+#include "focuserconfig.h"
+#include "generalDefinitions.h"
+#include "tmcshadow.h"
+
+#if (DRVBRD == PRO2ESP32TMC2225) || (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
+
+// ======================================================================
+// Data
+// ======================================================================
+portMUX_TYPE tmcMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ======================================================================
+// TmcShadow
+// ======================================================================
+// nothing is known about the driver registers, so the first write of each register is always sent
+void TmcShadow::begin(TmcDriver *drv)
+{
+  driver   = drv;
+  pending  = 0;
+  writes   = 0;
+  skipped  = 0;
+  reads    = 0;
+  status   = 0;
+  sg       = 0;
+  lastpoll = millis();
+  nextpoll = 0;
+  for ( byte i = 0; i < TMCREGS; i++ )
+  {
+    value[i]   = 0;
+    written[i] = 0xffffffffUL;
+  }
+}
+
+void TmcShadow::set(byte reg, uint32_t val)
+{
+  portENTER_CRITICAL(&tmcMux);
+  value[reg] = val;
+  if ( val != written[reg] )
+  {
+    pending |= (1UL << reg);
+  }
+  else
+  {
+    pending &= ~(1UL << reg);
+    skipped++;
+  }
+  portEXIT_CRITICAL(&tmcMux);
+}
+
+uint32_t TmcShadow::get(byte reg)
+{
+  return value[reg];
+}
+
+// send the pending writes, one UART transaction each
+void TmcShadow::flush(void)
+{
+  while ( pending != 0 )
+  {
+    byte reg = 0;
+    uint32_t val;
+    portENTER_CRITICAL(&tmcMux);
+    while ( (pending & (1UL << reg)) == 0 )
+    {
+      reg++;
+    }
+    pending &= ~(1UL << reg);
+    val = value[reg];
+    written[reg] = val;
+    portEXIT_CRITICAL(&tmcMux);
+    this->write(reg, val);
+  }
+}
+
+void TmcShadow::write(byte reg, uint32_t val)
+{
+  switch ( reg )
+  {
+    case TMCREG_MRES:
+      driver->microsteps(val);
+      break;
+    case TMCREG_CURRENT:
+      driver->rms_current(val);
+      break;
+    case TMCREG_TPWMTHRS:
+      driver->TPWMTHRS(val);
+      break;
+#if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
+    case TMCREG_SGTHRS:
+      driver->SGTHRS(val);
+      break;
+    case TMCREG_TCOOLTHRS:
+      driver->TCOOLTHRS(val);
+      break;
+    case TMCREG_SEMIN:
+      driver->semin(val);
+      break;
+#endif
+  }
+  writes++;
+}
+
+// status is read in the background so readers never wait on the UART
+void TmcShadow::poll(void)
+{
+  if ( (millis() - lastpoll) < TMCPOLLINTERVAL )
+  {
+    return;
+  }
+  lastpoll = millis();
+#if (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
+  if ( nextpoll == 1 )
+  {
+    sg = driver->SG_RESULT();
+  }
+  else
+#endif
+  {
+    status = driver->DRV_STATUS();
+  }
+  nextpoll = ( nextpoll == 0 ) ? 1 : 0;
+  reads++;
+}
+
+uint32_t TmcShadow::drvstatus(void)
+{
+  return status;
+}
+
+uint16_t TmcShadow::sgresult(void)
+{
+  return sg;
+}
+
+#endif // #if (DRVBRD == PRO2ESP32TMC2225) || (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
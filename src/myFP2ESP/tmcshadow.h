@@ -0,0 +1,54 @@
+// ======================================================================
+// tmcshadow.h : myFP2ESP TMC DRIVER SHADOW REGISTERS
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+#ifndef tmcshadow_h
+#define tmcshadow_h
+
+#include <Arduino.h>
+#include "focuserconfig.h"
+#include "generalDefinitions.h"
+
+#if (DRVBRD == PRO2ESP32TMC2225) || (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
+#if (DRVBRD == PRO2ESP32TMC2225)
+#include <TMC2208Stepper.h>
+typedef TMC2208Stepper TmcDriver;
+#else
+#include <TMCStepper.h>
+typedef TMC2209Stepper TmcDriver;
+#endif
+
+// ======================================================================
+// TMC SHADOW : settings written to the driver over the UART
+// ======================================================================
+// Writes are held as pending values and sent by flush(), a write of the value the driver already has is
+// skipped. Any task may call set(), only the motion task calls flush() and poll(), so the UART has one user.
+class TmcShadow
+{
+  public:
+    void begin(TmcDriver *);
+    void set(byte, uint32_t);                     // register TMCREG_, value
+    uint32_t get(byte);                           // value the driver has, or will have after flush()
+    void flush(void);                             // write pending values
+    void poll(void);                              // read back one status register every TMCPOLLINTERVAL
+    uint32_t drvstatus(void);                     // last DRV_STATUS read
+    uint16_t sgresult(void);                      // last SG_RESULT read, tmc2209
+    uint32_t writes;                              // UART writes sent
+    uint32_t skipped;                             // writes skipped, value not changed
+    uint32_t reads;                               // UART reads
+  private:
+    void write(byte, uint32_t);
+    TmcDriver *driver;
+    uint32_t value[TMCREGS];
+    uint32_t written[TMCREGS];
+    uint32_t pending;                             // bit per register
+    uint32_t status;
+    uint16_t sg;
+    unsigned long lastpoll;
+    byte nextpoll;
+};
+#endif // #if (DRVBRD == PRO2ESP32TMC2225) || (DRVBRD == PRO2ESP32TMC2209 || DRVBRD == PRO2ESP32TMC2209P)
+
+#endif // #ifndef tmcshadow_h
@@ -0,0 +1,54 @@
+// ======================================================================
+// velocity.h : myFP2ESP MOTOR VELOCITY TO STEP INTERVAL
+// (c) Copyright Robert Brown 2014-2021. All Rights Reserved.
+// (c) Copyright Holger M, 2019-2021. All Rights Reserved.
+// ======================================================================
+
+#ifndef velocity_h
+#define velocity_h
+
+#include <Arduino.h>
+#include "focuserconfig.h"                    // STEP1, STEP4, STEP256
+#include "generalDefinitions.h"
+
+// ======================================================================
+// Step intervals from the board and the motorvelocity setting
+// ======================================================================
+// No hardware or settings are used here, DriverBoard passes them in, see myBoards.cpp.
+
+// step interval [uS] for velocity in full steps/s (VELOCITY_FULLSTEPS) or um/s (VELOCITY_MICRONS)
+// stepmode is the microstep setting, stepsize the focuser step in um. returns 0 if there is no valid velocity
+inline unsigned long velocity_interval(unsigned long velocity, byte unit, int stepmode, float stepsize)
+{
+  float sps = 0.0;                              // focuser steps/s
+  if ( unit == VELOCITY_MICRONS )
+  {
+    sps = ( stepsize > 0.0 ) ? velocity / stepsize : 0.0;
+  }
+  else
+  {
+    sps = (float) velocity * stepmode;
+  }
+  return ( sps > 0.0 ) ? (unsigned long) (1000000.0 / sps) : 0;
+}
+
+// shortest safe step interval [uS] of a board at step mode smode. On TMC boards (tmc true) the board msdelay is
+// the interval for full steps, so it is divided by the microsteps, an invalid smode counts as STEP4
+inline unsigned long board_mininterval(unsigned long msdelay, bool tmc, int smode)
+{
+  if ( tmc )
+  {
+    smode = ( (smode >= STEP1) && (smode <= STEP256) && ((smode & (smode - 1)) == 0) ) ? smode : STEP4;
+    msdelay = msdelay / smode;
+  }
+  return ( msdelay < VELOCITYMININTERVAL ) ? VELOCITYMININTERVAL : msdelay;
+}
+
+// step interval [uS] for motorspeed FAST, from velocity if set, never shorter than the board minimum minspd
+inline unsigned long fast_interval(unsigned long velocity, byte unit, int stepmode, float stepsize, unsigned long minspd)
+{
+  unsigned long curspd = velocity_interval(velocity, unit, stepmode, stepsize);
+  return ( curspd < minspd ) ? minspd : curspd;
+}
+
+#endif // #ifndef velocity_h
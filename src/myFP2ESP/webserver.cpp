@@ -39,7 +39,6 @@ extern portMUX_TYPE  halt_alertMux;
 
 extern unsigned long ftargetPosition;           // target position
 extern char          ipStr[16];                 // shared between BT mode and other modes
-extern byte          isMoving;                  // is the motor currently moving
 extern bool          webserverstate;
 extern bool          reboot;
 extern int           tprobe1;
@@ -51,6 +50,7 @@ extern SetupData     *mySetupData;
 extern DriverBoard   *driverboard;
 extern OLED_NON      *myoled;
 extern void          heapmsg(void);
+extern void          motion_command(byte, long);
 
 // forward declarations
 void WEBSERVER_sendpresets(void);
@@ -67,10 +67,26 @@ ESP8266WebServer *webserver;
 WebServer *webserver;
 #endif // if defined(esp8266)
 String WSpg;
+long   ws_target = -1;                          // target sent by this request, not yet applied by the motion task
 
 // ======================================================================
 // WEBSERVER Code
 // ======================================================================
+// send a new target to the motion task, pages built for this request show it as the target
+void WEBSERVER_movetarget(unsigned long target)
+{
+  motion_command(MOTION_MOVE, (long) target);
+  ws_target = (long) target;
+}
+
+// target to show on a page, the snapshot target unless this request changed it
+unsigned long WEBSERVER_pagetarget(MotionState &ms)
+{
+  unsigned long target = ( ws_target < 0 ) ? ms.target : (unsigned long) ws_target;
+  ws_target = -1;
+  return target;
+}
+
 void WEBSERVER_sendACAOheader(void)
 {
   webserver->sendHeader("Access-Control-Allow-Origin", "*");
@@ -160,9 +176,11 @@ void WEBSERVER_buildpresets(void)
     WSpg.replace("%POR%", String(mySetupData->get_webserverport()));
     WSpg.replace("%VER%", String(programVersion));
     WSpg.replace("%NAM%", mySetupData->get_brdname());
-    WSpg.replace("%CPO%", String(driverboard->getposition()));
-    WSpg.replace("%TPO%", String(ftargetPosition));
-    WSpg.replace("%MOV%", String(isMoving));
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    WSpg.replace("%CPO%", String(ms.position));
+    WSpg.replace("%TPO%", String(WEBSERVER_pagetarget(ms)));
+    WSpg.replace("%MOV%", String(ms.moving));
 
     WSpg.replace("%WSP0%", String(mySetupData->get_focuserpreset(0)));
     WSpg.replace("%WSP1%", String(mySetupData->get_focuserpreset(1)));
@@ -201,9 +219,7 @@ void WEBSERVER_handlepresets(void)
   {
     TRACE();
     WebS_DebugPrintln(halt_str);
-    varENTER_CRITICAL(&halt_alertMux);
-    halt_alert = true;
-    varEXIT_CRITICAL(&halt_alertMux);
+    motion_command(MOTION_HALT, 0);
     // ftargetPosition = fcurrentPosition;
   }
 
@@ -242,7 +258,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(0, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -282,7 +298,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(1, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -321,7 +337,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(2, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -360,7 +376,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(3, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -399,7 +415,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(4, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -438,7 +454,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(5, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -477,7 +493,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(6, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -516,7 +532,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(7, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -555,7 +571,7 @@ void WEBSERVER_handlepresets(void)
       temp = (temp < 0) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(8, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -594,7 +610,7 @@ void WEBSERVER_handlepresets(void)
       temp = ( temp < 0 ) ? 0 : temp;
       temp = ( temp > (long)mySetupData->get_maxstep()) ? (long) mySetupData->get_maxstep() : temp;
       mySetupData->set_focuserpreset(9, (unsigned long) temp);
-      ftargetPosition = temp;
+      WEBSERVER_movetarget(temp);
     }
   }
 
@@ -653,9 +669,11 @@ void WEBSERVER_buildmove(void)
     WSpg.replace("%POR%", String(mySetupData->get_webserverport()));
     WSpg.replace("%VER%", String(programVersion));
     WSpg.replace("%NAM%", mySetupData->get_brdname());
-    WSpg.replace("%CPO%", String(driverboard->getposition()));
-    WSpg.replace("%TPO%", String(ftargetPosition));
-    WSpg.replace("%MOV%", String(isMoving));
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    WSpg.replace("%CPO%", String(ms.position));
+    WSpg.replace("%TPO%", String(WEBSERVER_pagetarget(ms)));      // target may have been changed by this request
+    WSpg.replace("%MOV%", String(ms.moving));
   }
   else
   {
@@ -702,9 +720,7 @@ void WEBSERVER_handlemove()
   {
     TRACE();
     WebS_DebugPrintln(halt_str);
-    varENTER_CRITICAL(&halt_alertMux);
-    halt_alert = true;
-    varEXIT_CRITICAL(&halt_alertMux);
+    motion_command(MOTION_HALT, 0);
     //ftargetPosition = fcurrentPosition;
   }
 
@@ -716,15 +732,17 @@ void WEBSERVER_handlemove()
     TRACE();
     WebS_DebugPrintln(fmv_str);
     temp = fmv_str.toInt();
-    long newtemp = (long) driverboard->getposition() + temp;
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    long newtemp = (long) ms.position + temp;
     newtemp = ( newtemp < 0 ) ? 0 : newtemp;
     newtemp = ( newtemp > (long)mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : newtemp;
-    ftargetPosition = (unsigned long) newtemp;
+    WEBSERVER_movetarget((unsigned long) newtemp);
     WebS_DebugPrint("Move = "); WebS_DebugPrintln(fmv_str);
     WebS_DebugPrint("Position:");
-    WebS_DebugPrintln(driverboard->getposition());
+    WebS_DebugPrintln(ms.position);
     WebS_DebugPrint("Target");
-    WebS_DebugPrintln(ftargetPosition);
+    WebS_DebugPrintln(newtemp);
   }
 
   WEBSERVER_sendmove();
@@ -765,18 +783,21 @@ void WEBSERVER_buildhome(void)
     WSpg.replace("%VER%", String(programVersion));
     WSpg.replace("%NAM%", mySetupData->get_brdname());
     // if this is a GOTO command then make this target else make current
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    unsigned long target = WEBSERVER_pagetarget(ms);           // target may have been changed by this request
     String fp_str = webserver->arg("gotopos");
     if ( fp_str != "" )
     {
-      WSpg.replace("%CPO%", String(ftargetPosition));
+      WSpg.replace("%CPO%", String(target));
     }
     else
     {
-      WSpg.replace("%CPO%", String(driverboard->getposition()));
+      WSpg.replace("%CPO%", String(ms.position));
     }
-    WSpg.replace("%TPO%", String(ftargetPosition));
+    WSpg.replace("%TPO%", String(target));
     WSpg.replace("%MAX%", String(mySetupData->get_maxstep()));
-    WSpg.replace("%MOV%", String(isMoving));
+    WSpg.replace("%MOV%", String(ms.moving));
 
     if ( mySetupData->get_tempmode() == 1)
     {
@@ -945,9 +966,7 @@ void WEBSERVER_handleroot()
   {
     WebS_DebugPrint("root() -halt:");
     WebS_DebugPrintln(halt_str);
-    varENTER_CRITICAL(&halt_alertMux);
-    halt_alert = true;
-    varEXIT_CRITICAL(&halt_alertMux);
+    motion_command(MOTION_HALT, 0);
     //ftargetPosition = fcurrentPosition;
   }
 
@@ -966,9 +985,9 @@ void WEBSERVER_handleroot()
       WebS_DebugPrintln(fp);
       temp = fp.toInt();
       temp = (temp < 0) ? 0 : temp;
-      ftargetPosition = ( temp > (long)mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : (unsigned long)temp;
-      driverboard->setposition(ftargetPosition);
-      mySetupData->set_fposition(ftargetPosition);
+      temp = ( temp > (long)mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : temp;
+      motion_command(MOTION_SETPOSITION, temp);
+      ws_target = temp;
     }
   }
 
@@ -986,7 +1005,7 @@ void WEBSERVER_handleroot()
       WebS_DebugPrintln(fp);
       temp = fp.toInt();
       temp = (temp < 0) ? 0 : temp;
-      ftargetPosition = ( temp > (long)mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : (unsigned long)temp;
+      WEBSERVER_movetarget(( temp > (long)mySetupData->get_maxstep()) ? mySetupData->get_maxstep() : (unsigned long)temp);
     }
   }
 
@@ -998,9 +1017,11 @@ void WEBSERVER_handleroot()
     WebS_DebugPrint("root() -maxsteps:");
     WebS_DebugPrintln(fmax_str);
     temp = fmax_str.toInt();
-    if ( temp < (long) driverboard->getposition() )               // if maxstep is less than focuser position
+    MotionState ms;
+    driverboard->getmotionstate(ms);
+    if ( temp < (long) ms.position )                              // if maxstep is less than focuser position
     {
-      temp = (long) driverboard->getposition() + 1;
+      temp = (long) ms.position + 1;
     }
     if ( temp < FOCUSERLOWERLIMIT )                     // do not set it less then 1024
     {
@@ -1066,7 +1087,7 @@ void WEBSERVER_handleroot()
 
   // ======================================================================
   // Basic rule for setting stepmode
-  // Set driverboard->setstepmode(xx);                 // this sets the physical pins and saves new stepmode
+  // Send motion_command(MOTION_STEPMODE, xx);          // the motion task sets the physical pins and saves new stepmode
   // ======================================================================
   // if update stepmode
   // (1=Full, 2=Half, 4=1/4, 8=1/8, 16=1/16, 32=1/32, 64=1/64, 128=1/128, 256=1/256)
@@ -1085,7 +1106,7 @@ void WEBSERVER_handleroot()
     {
       temp1 = mySetupData->get_brdmaxstepmode();
     }
-    driverboard->setstepmode(temp1);
+    motion_command(MOTION_STEPMODE, temp1);
   }
 
   // if update temperature resolution
@@ -1126,12 +1147,12 @@ void WEBSERVER_handleroot()
       if ( d_str == "don" )
       {
         mySetupData->set_displayenabled(1);
-        myoled->display_on();
+        motion_command(MOTION_DISPLAYON, 0);
       }
       else
       {
         mySetupData->set_displayenabled(0);
-        myoled->display_off();
+        motion_command(MOTION_DISPLAYOFF, 0);
       }
     }
   }
@@ -1167,17 +1188,23 @@ void WEBSERVER_sendroot(void)
 
 void WEBSERVER_handleposition()
 {
-  webserver->send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, String(driverboard->getposition())); // Send position value only to client ajax request
+  MotionState ms;
+  driverboard->getmotionstate(ms);
+  webserver->send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, String(ms.position));     // Send position value only to client ajax request
 }
 
 void WEBSERVER_handleismoving()
 {
-  webserver->send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, String(isMoving));          // Send isMoving value only to client ajax request
+  MotionState ms;
+  driverboard->getmotionstate(ms);
+  webserver->send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, String(ms.moving));       // Send isMoving value only to client ajax request
 }
 
 void WEBSERVER_handletargetposition()
 {
-  webserver->send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, String(ftargetPosition));   //Send targetPosition value only to client ajax request
+  MotionState ms;
+  driverboard->getmotionstate(ms);
+  webserver->send(NORMALWEBPAGE, PLAINTEXTPAGETYPE, String(ms.target));       //Send targetPosition value only to client ajax request
 }
 
 void WEBSERVER_handletemperature()